@@ -0,0 +1,95 @@
+#ifndef ALPHABET_HPP
+#define ALPHABET_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sopang
+{
+
+/*
+ *** ALPHABETS
+ */
+
+// Alphabets are compile-time parameters of BasicSopang. A symbol is mapped to a dense code by masking the lowest bits
+// of its ASCII value, the mask is chosen per alphabet so that no two symbols share a code (checked at compile time).
+// Hence Shift-Or masks are stored in a tiny array indexed by code and translating a text character costs a single AND.
+
+/** Symbol -> code mapping for all char values. */
+using CodeTable = std::array<uint8_t, 256>;
+
+/** Code table entry for characters outside the alphabet. */
+constexpr uint8_t invalidCode = 0xFF;
+
+template<size_t N>
+constexpr CodeTable makeCodeTable(const char (&symbols)[N], unsigned codeMask)
+{
+    CodeTable table {};
+
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        table[i] = invalidCode;
+    }
+
+    // The last character is the null terminator.
+    for (size_t i = 0; i + 1 < N; ++i)
+    {
+        table[static_cast<unsigned char>(symbols[i])] = static_cast<uint8_t>(static_cast<unsigned char>(symbols[i]) & codeMask);
+    }
+
+    return table;
+}
+
+template<size_t N>
+constexpr bool areCodesUnique(const char (&symbols)[N], unsigned codeMask)
+{
+    for (size_t i = 0; i + 1 < N; ++i)
+    {
+        for (size_t j = i + 1; j + 1 < N; ++j)
+        {
+            if ((static_cast<unsigned char>(symbols[i]) & codeMask) == (static_cast<unsigned char>(symbols[j]) & codeMask))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/** Nucleotides and N (unknown nucleotide), matches the output of the data generation tools from the scripts folder.
+ * Codes: A = 1, C = 3, G = 7, T = 4, N = 6. */
+struct DnaAlphabet
+{
+    static constexpr char symbols[] = "ACGTN";
+    static constexpr unsigned codeMask = 0x7;
+    /** Number of codes, i.e. the size of a mask array indexed by code. */
+    static constexpr size_t codeCount = codeMask + 1;
+
+    static constexpr CodeTable codeTable = makeCodeTable(symbols, codeMask);
+
+    static constexpr unsigned code(char c) { return static_cast<unsigned char>(c) & codeMask; }
+    static constexpr bool isValid(char c) { return codeTable[static_cast<unsigned char>(c)] != invalidCode; }
+};
+
+/** Upper-case letters, covers amino acids together with ambiguity codes. Codes: A = 1, ..., Z = 26. */
+struct ProteinAlphabet
+{
+    static constexpr char symbols[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    static constexpr unsigned codeMask = 0x1F;
+    /** Number of codes, i.e. the size of a mask array indexed by code. */
+    static constexpr size_t codeCount = codeMask + 1;
+
+    static constexpr CodeTable codeTable = makeCodeTable(symbols, codeMask);
+
+    static constexpr unsigned code(char c) { return static_cast<unsigned char>(c) & codeMask; }
+    static constexpr bool isValid(char c) { return codeTable[static_cast<unsigned char>(c)] != invalidCode; }
+};
+
+static_assert(areCodesUnique(DnaAlphabet::symbols, DnaAlphabet::codeMask), "DNA symbols must have unique codes");
+static_assert(areCodesUnique(ProteinAlphabet::symbols, ProteinAlphabet::codeMask), "protein symbols must have unique codes");
+
+static_assert(DnaAlphabet::isValid('A') and DnaAlphabet::isValid('N') and not DnaAlphabet::isValid('B'), "invalid DNA code table");
+
+} // namespace sopang
+
+#endif // ALPHABET_HPP
@@ -0,0 +1,128 @@
+#ifndef ED_TEXT_HPP
+#define ED_TEXT_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sopang
+{
+
+/** Elastic-degenerate text stored in a flat (CSR-style) layout.
+ * All variant characters are kept back to back in a single padded character arena.
+ * Variant v spans arena positions [variantOffsets[v], variantOffsets[v + 1]),
+ * segment s consists of variants [segmentOffsets[s], segmentOffsets[s + 1]). */
+class EdText
+{
+public:
+    EdText();
+    /** Builds a flat text from the segment arrays returned by parsing::parseTextArray. */
+    EdText(const std::string *const *segments, int nSegments, const int *segmentSizes);
+
+    /** Appends [c] to the variant which is currently being built. */
+    void appendChar(char c);
+    /** Closes the variant which is currently being built (possibly empty). */
+    void closeVariant();
+    /** Closes the segment which is currently being built, it consists of all variants closed since the previous segment. */
+    void closeSegment();
+
+    int nSegments() const { return static_cast<int>(segmentOffsets.size()) - 1; }
+    /** Number of variants in segment [segmentIdx]. */
+    int segmentSize(int segmentIdx) const { return segmentOffsets[segmentIdx + 1] - segmentOffsets[segmentIdx]; }
+    /** Largest number of variants in a single segment, tracked while the text is built. */
+    int maxSegmentSize() const { return maxSegmentVariantCount; }
+    /** Total number of characters (padding excluded). */
+    size_t size() const { return variantOffsets.back(); }
+
+    const char *variantBegin(int segmentIdx, int variantIdx) const;
+    int variantSize(int segmentIdx, int variantIdx) const;
+
+    std::string variantStr(int segmentIdx, int variantIdx) const;
+
+    /** Raw access for matching kernels. */
+    const char *charData() const { return arena.data(); }
+    const size_t *variantOffsetData() const { return variantOffsets.data(); }
+    const int *segmentOffsetData() const { return segmentOffsets.data(); }
+
+    /** Number of zero characters stored after the last variant, allows word-sized reads past the text end. */
+    static constexpr size_t arenaPadding = 8;
+
+private:
+    std::vector<char> arena;
+
+    std::vector<size_t> variantOffsets;
+    std::vector<int> segmentOffsets;
+
+    int maxSegmentVariantCount = 0;
+};
+
+inline EdText::EdText()
+    :arena(arenaPadding, '\0'),
+     variantOffsets{ 0 },
+     segmentOffsets{ 0 }
+{ }
+
+inline EdText::EdText(const std::string *const *segments, int nSegments, const int *segmentSizes)
+    :EdText()
+{
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        for (int iV = 0; iV < segmentSizes[iS]; ++iV)
+        {
+            for (const char c : segments[iS][iV])
+            {
+                appendChar(c);
+            }
+
+            closeVariant();
+        }
+
+        closeSegment();
+    }
+}
+
+inline void EdText::appendChar(char c)
+{
+    // The padding is kept at the end of the arena, the new character overwrites its first byte.
+    arena[arena.size() - arenaPadding] = c;
+    arena.push_back('\0');
+}
+
+inline void EdText::closeVariant()
+{
+    variantOffsets.push_back(arena.size() - arenaPadding);
+}
+
+inline void EdText::closeSegment()
+{
+    assert(static_cast<int>(variantOffsets.size()) - 1 > segmentOffsets.back());
+    segmentOffsets.push_back(static_cast<int>(variantOffsets.size()) - 1);
+
+    maxSegmentVariantCount = std::max(maxSegmentVariantCount, segmentSize(nSegments() - 1));
+}
+
+inline const char *EdText::variantBegin(int segmentIdx, int variantIdx) const
+{
+    assert(variantIdx < segmentSize(segmentIdx));
+    return arena.data() + variantOffsets[segmentOffsets[segmentIdx] + variantIdx];
+}
+
+inline int EdText::variantSize(int segmentIdx, int variantIdx) const
+{
+    assert(variantIdx < segmentSize(segmentIdx));
+    const int v = segmentOffsets[segmentIdx] + variantIdx;
+
+    return static_cast<int>(variantOffsets[v + 1] - variantOffsets[v]);
+}
+
+inline std::string EdText::variantStr(int segmentIdx, int variantIdx) const
+{
+    const char *begin = variantBegin(segmentIdx, variantIdx);
+    return std::string(begin, begin + variantSize(segmentIdx, variantIdx));
+}
+
+} // namespace sopang
+
+#endif // ED_TEXT_HPP
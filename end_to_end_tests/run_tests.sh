@@ -14,16 +14,77 @@ echo "3/4 Running"
 ./sopang text_test.eds patterns_test.txt > $outFile
 python3 check_result.py "2 1 1 1 1 2 1 1"
 
+./sopang text_test.eds patterns_test.txt --batch > $outFile
+python3 check_result.py "2 1 1 1 1 2 1 1"
+
+./sopang text_test.eds patterns_test.txt --text-threads 3 > $outFile
+python3 check_result.py "2 1 1 1 1 2 1 1"
+
+./sopang text_test.eds patterns_test.txt --threads 4 > $outFile
+python3 check_result.py "2 1 1 1 1 2 1 1"
+
+./sopang text_test.eds patterns_test.txt --count-only > $outFile
+python3 check_result.py "2 1 1 1 1 2 1 1"
+
+./sopang text_test.eds patterns_test.txt --exists-only > $outFile
+python3 check_result.py "1 1 1 1 1 1 1 1"
+
+./sopang text_test.eds patterns_test.txt --first-n 1 > $outFile
+python3 check_result.py "1 1 1 1 1 1 1 1"
+
 # Approx
 ./sopang text_test.eds patterns_test.txt -k 1 > $outFile
 python3 check_result.py "2 3 3 3 3 3 1 1"
 
+./sopang text_test.eds patterns_test.txt -k 1 --edit > $outFile
+python3 check_result.py "2 3 3 4 3 4 2 2"
+
+./sopang text_test.eds patterns_test.txt -k 1 --filter > $outFile
+python3 check_result.py "2 3 3 3 3 3 1 1"
+
+./sopang text_test.eds patterns_test.txt -k 1 --min-distance > $outFile
+python3 check_result.py "2 3 3 3 3 3 1 1"
+
 # With sources
 ./sopang text_test.eds patterns_test.txt -S sources_test.edss > $outFile
 python3 check_result.py "2 1 1 1 1 2 0 1"
 
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --exists-only > $outFile
+python3 check_result.py "1 1 1 1 1 1 0 1"
+
 ./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output > $outFile
 python3 check_result.py "2 1 1 1 1 2 0 1"
 
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output --threads 4 > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output --breadcrumbs > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --sources-engine forward > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output --sources-engine forward > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --sources-engine haplotype > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output --sources-engine haplotype --haplotype-classes 2 > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --sources-engine pbwt > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+./sopang text_test.eds patterns_test.txt -S sources_test.edss --full-sources-output --sources-engine pbwt > $outFile
+python3 check_result.py "2 1 1 1 1 2 0 1"
+
+# Approx with sources
+./sopang text_test.eds patterns_test.txt -k 1 -S sources_test.edss > $outFile
+python3 check_result.py "2 3 3 3 3 3 1 1"
+
+./sopang text_test.eds patterns_test.txt -k 1 -S sources_test.edss --full-sources-output > $outFile
+python3 check_result.py "2 3 3 3 3 3 1 1"
+
 echo "4/4 Teardown"
 rm -f sopang $outFile
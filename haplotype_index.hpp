@@ -0,0 +1,205 @@
+#ifndef HAPLOTYPE_INDEX_HPP
+#define HAPLOTYPE_INDEX_HPP
+
+#include "ed_text.hpp"
+#include "source_map.hpp"
+#include "source_set.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace sopang
+{
+
+/** Haplotype classes of sources within blocks of consecutive segments, stored in a flat (CSR-style) layout.
+ * All sources of a class take the same variant of each segment of a block, hence the block text is materialized
+ * as a single linear string per class. Block b consists of segments [blockSegmentOffsets[b], blockSegmentOffsets[b + 1])
+ * and classes [blockClassOffsets[b], blockClassOffsets[b + 1]), the text of class c spans arena positions [classOffsets[c], classOffsets[c + 1]).
+ * Segment ends within the text of class c (relative to its start) are stored from segmentEnds[segmentEndOffsets[c]], one for each block segment. */
+class HaplotypeIndex
+{
+public:
+    HaplotypeIndex() = default;
+    /** Builds blocks for [edText] with [sourceMap] having [sourceCount] sources, each source has to occur in exactly one variant
+     * of each non-deterministic segment (see SourceMap::calcSourceVariants). A block is closed before the segment which would split its sources into more than [maxClasses] classes,
+     * hence only a block consisting of a single segment with more variants can exceed the limit. */
+    HaplotypeIndex(const EdText &edText, const SourceMap &sourceMap, int sourceCount, int maxClasses = defaultMaxClasses);
+
+    bool empty() const { return blockSegmentOffsets.size() <= 1; }
+    int sourceCount() const { return nSources; }
+
+    int nBlocks() const { return static_cast<int>(blockSegmentOffsets.size()) - 1; }
+    int nClasses() const { return static_cast<int>(classSourceSets.size()); }
+
+    /** Segments [blockBegin, blockEnd) of block [blockIdx]. */
+    int blockBegin(int blockIdx) const { return blockSegmentOffsets[blockIdx]; }
+    int blockEnd(int blockIdx) const { return blockSegmentOffsets[blockIdx + 1]; }
+
+    /** Classes [classBegin, classEnd) of block [blockIdx]. */
+    int classBegin(int blockIdx) const { return blockClassOffsets[blockIdx]; }
+    int classEnd(int blockIdx) const { return blockClassOffsets[blockIdx + 1]; }
+
+    const char *classText(int classIdx) const { return arena.data() + classOffsets[classIdx]; }
+    size_t classSize(int classIdx) const { return classOffsets[classIdx + 1] - classOffsets[classIdx]; }
+    const SourceSet &classSources(int classIdx) const { return classSourceSets[classIdx]; }
+
+    /** Ends of the segments of the block containing class [classIdx] within its text, the i-th end belongs to the i-th block segment. */
+    const size_t *classSegmentEnds(int classIdx) const { return segmentEnds.data() + segmentEndOffsets[classIdx]; }
+
+    size_t sizeInBytes() const;
+
+    /** Default maximum number of classes per block. */
+    static constexpr int defaultMaxClasses = 16;
+
+private:
+    /** Materializes the block ending before segment [segmentEnd], class c takes variants classPaths[c] of the block segments. */
+    void closeBlock(const EdText &edText, int segmentEnd,
+        const std::vector<std::vector<int>> &classPaths,
+        const std::vector<int> &sourceClasses);
+
+    int nSources = 0;
+
+    std::vector<int> blockSegmentOffsets{ 0 };
+    std::vector<int> blockClassOffsets{ 0 };
+
+    std::vector<char> arena;
+    std::vector<size_t> classOffsets{ 0 };
+
+    std::vector<size_t> segmentEnds;
+    std::vector<size_t> segmentEndOffsets{ 0 };
+
+    std::vector<SourceSet> classSourceSets;
+};
+
+inline HaplotypeIndex::HaplotypeIndex(const EdText &edText, const SourceMap &sourceMap, int sourceCount, int maxClasses)
+    :nSources(sourceCount)
+{
+    assert(maxClasses > 0);
+
+    // Each class is identified by the variants taken in the current block, a new segment refines the classes.
+    std::vector<std::vector<int>> classPaths(1), nextClassPaths;
+    std::vector<int> sourceClasses(sourceCount, 0), nextSourceClasses(sourceCount);
+
+    std::vector<int> sourceVariants(sourceCount);
+    std::vector<int> refinedClasses;
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        if (not sourceMap.hasSources(iS))
+        {
+            for (std::vector<int> &path : classPaths)
+            {
+                path.push_back(0);
+            }
+
+            continue;
+        }
+
+        assert(sourceMap.segmentSize(iS) == edText.segmentSize(iS));
+        sourceMap.calcSourceVariants(iS, sourceCount, sourceVariants);
+
+        const int nVariants = sourceMap.segmentSize(iS);
+
+        for (bool closed = false; ; closed = true)
+        {
+            // (class, variant) -> refined class.
+            refinedClasses.assign(classPaths.size() * nVariants, -1);
+            nextClassPaths.clear();
+
+            for (int iSource = 0; iSource < sourceCount; ++iSource)
+            {
+                int &refined = refinedClasses[sourceClasses[iSource] * nVariants + sourceVariants[iSource]];
+
+                if (refined == -1)
+                {
+                    refined = static_cast<int>(nextClassPaths.size());
+
+                    nextClassPaths.push_back(classPaths[sourceClasses[iSource]]);
+                    nextClassPaths.back().push_back(sourceVariants[iSource]);
+                }
+
+                nextSourceClasses[iSource] = refined;
+            }
+
+            // Closing a block with a single class would not reduce the number of classes.
+            if (closed or static_cast<int>(nextClassPaths.size()) <= maxClasses or classPaths.size() == 1)
+                break;
+
+            closeBlock(edText, iS, classPaths, sourceClasses);
+
+            classPaths.assign(1, std::vector<int>());
+            std::fill(sourceClasses.begin(), sourceClasses.end(), 0);
+        }
+
+        std::swap(classPaths, nextClassPaths);
+        std::swap(sourceClasses, nextSourceClasses);
+    }
+
+    if (edText.nSegments() > 0)
+    {
+        closeBlock(edText, edText.nSegments(), classPaths, sourceClasses);
+    }
+}
+
+inline size_t HaplotypeIndex::sizeInBytes() const
+{
+    size_t res = (blockSegmentOffsets.size() + blockClassOffsets.size()) * sizeof(int) + arena.size()
+        + (classOffsets.size() + segmentEnds.size() + segmentEndOffsets.size()) * sizeof(size_t);
+
+    for (const SourceSet &sourceSet : classSourceSets)
+    {
+        res += sourceSet.sizeInBytes();
+    }
+
+    return res;
+}
+
+inline void HaplotypeIndex::closeBlock(const EdText &edText, int segmentEnd,
+    const std::vector<std::vector<int>> &classPaths,
+    const std::vector<int> &sourceClasses)
+{
+    const int segmentBegin = blockSegmentOffsets.back();
+    const int firstClass = nClasses();
+
+    for (size_t iC = 0; iC < classPaths.size(); ++iC)
+    {
+        assert(static_cast<int>(classPaths[iC].size()) == segmentEnd - segmentBegin);
+        size_t size = 0;
+
+        for (int iS = segmentBegin; iS < segmentEnd; ++iS)
+        {
+            const char *begin = edText.variantBegin(iS, classPaths[iC][iS - segmentBegin]);
+            const int variantSize = edText.variantSize(iS, classPaths[iC][iS - segmentBegin]);
+
+            arena.insert(arena.end(), begin, begin + variantSize);
+            size += variantSize;
+
+            segmentEnds.push_back(size);
+        }
+
+        classOffsets.push_back(arena.size());
+        segmentEndOffsets.push_back(segmentEnds.size());
+
+        classSourceSets.emplace_back(nSources);
+    }
+
+    for (int iSource = 0; iSource < nSources; ++iSource)
+    {
+        classSourceSets[firstClass + sourceClasses[iSource]].set(iSource);
+    }
+
+    for (int iC = firstClass; iC < nClasses(); ++iC)
+    {
+        classSourceSets[iC].compact();
+    }
+
+    blockSegmentOffsets.push_back(segmentEnd);
+    blockClassOffsets.push_back(nClasses());
+}
+
+} // namespace sopang
+
+#endif // HAPLOTYPE_INDEX_HPP
@@ -10,16 +10,20 @@
 #include "params.hpp"
 #include "parsing.hpp"
 #include "sopang.hpp"
+#include "thread_pool.hpp"
 #include "zstd_helper.hpp"
 
+#include <algorithm>
 #include <cassert>
-#include <ctime>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <boost/format.hpp>
@@ -28,6 +32,9 @@
 using namespace sopang;
 using namespace std;
 
+/** Sopang instantiated for the alphabet selected in params. */
+using AlphabetSopang = BasicSopang<Params::Alphabet>;
+
 namespace po = boost::program_options;
 
 namespace sopang
@@ -43,13 +50,6 @@ constexpr int paramsResContinue = -1;
 
 }
 
-struct SegmentData
-{
-    const string *const *segments;
-    int nSegments; // Number of segments.
-    const int *segmentSizes; // Size of each segment (number of variants).
-};
-
 /** Handles cmd-line parameters, returns paramsResContinue if program execution should continue. */
 int handleParams(int argc, const char **argv);
 /** Returns true if input files are readable, false otherwise. */
@@ -59,29 +59,84 @@ int run();
 
 string readInputText();
 vector<string> readPatterns();
-vector<vector<Sopang::SourceSet>> readSources(int nSegments, const int *segmentSizes, int &sourceCount);
+vector<vector<AlphabetSopang::SourceSet>> readSources(const EdText &edText, int &sourceCount);
+
+/** Indexes built from the source map for the sources engine selected in params, the ones of other engines are empty. */
+struct SourcesIndexes
+{
+    AlphabetSopang::HaplotypeIndex haplotypeIndex;
+    AlphabetSopang::PbwtIndex pbwtIndex;
+};
 
-/** Runs sopang for [segmentData] and [sourceMap] (which may be empty) having [sourceCount] sources, searching for [patterns]. */
-void runSopang(const SegmentData &segmentData, 
-    const Sopang::SourceMap &sourceMap,
+/** Runs sopang for [edText] and [sourceMap] (which may be empty) having [sourceCount] sources, searching for [patterns]. */
+void runSopang(const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
     int sourceCount,
     const vector<string> &patterns);
 
-/** Calculates total [textSize] in bytes and corresponding [textSizeMB] in megabytes (10^6) for [segmentData]. */
-void calcTextSize(const SegmentData &segmentData, int &textSize, double &textSizeMB);
+/** Calculates total [textSize] in bytes and corresponding [textSizeMB] in megabytes (10^6) for [edText]. */
+void calcTextSize(const EdText &edText, int &textSize, double &textSizeMB);
+
+/** Results of a single pattern query. */
+struct QueryResult
+{
+    /** Number of matching indexes (for the exists-only mode: 1 if there is any match, 0 otherwise). */
+    int nResults = 0;
+    /** Number of matching sources, set only when counting sources. */
+    int nMatchingSources = Params::noValue;
+
+    /** Matching indexes in increasing order, empty for the count-only and exists-only modes. */
+    vector<int> indexes;
+    /** Sources for each matching index, filled only for the full sources output. */
+    map<int, AlphabetSopang::SourceSet> sources;
+    /** Minimum number of mismatches for each matching index, filled only for the minimum distance output. */
+    map<int, int> distances;
+
+    double elapsedSec = 0.0;
+};
+
+/** Returns the progress message printed before the results for [iP]-th pattern out of [patterns]. */
+string calcQueryMessage(size_t iP, const vector<string> &patterns);
 
-/** Searches for [pattern] in [segmentData] and [sourceMap] (which may be empty) having [sourceCount] sources and returns elapsed time in seconds. */
-double measure(const SegmentData &segmentData,
-    const Sopang::SourceMap &sourceMap,
+/** Searches for [pattern] using [sopang] in [edText] and [sourceMap] (which may be empty) having [sourceCount] sources,
+ * returns the results together with elapsed time in seconds. */
+QueryResult measure(AlphabetSopang &sopang,
+    const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
     int sourceCount,
     const string &pattern);
 
-void dumpMedians(const vector<double> &elapsedSecVec, double textSizeMB);
+/** Searches for [pattern] using a variant of matching selected by params, delivers matches to [sink] and returns elapsed time in seconds. */
+template<typename Sink>
+double measureSink(AlphabetSopang &sopang,
+    const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
+    int sourceCount,
+    const string &pattern,
+    Sink &sink);
+
+/** Searches for [patterns] distributed over a pool of params.nThreads workers, each worker owns a single Sopang instance.
+ * Results are reported in the pattern order, returns elapsed time in seconds for each pattern. */
+vector<double> measureParallel(const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
+    int sourceCount,
+    const vector<string> &patterns);
 
-void dumpSources(int index, const Sopang::SourceSet &sources);
-void dumpIndexes(const unordered_set<int> &indexes);
+/** Prints the number of results and dumps them if requested. */
+void reportResult(const QueryResult &result);
 
-void clearMemory(SegmentData &segmentData);
+/** Searches for all [patterns] in [edText] in a single pass and returns elapsed time in seconds per pattern (total time divided by the pattern count). */
+double measureBatch(const EdText &edText, const vector<string> &patterns);
+
+void dumpMedians(const vector<double> &elapsedSecVec, double textSizeMB);
+
+void dumpSources(int index, const AlphabetSopang::SourceSet &sources);
+/** Dumps [indexes] which are sorted in increasing order. */
+void dumpIndexes(const vector<int> &indexes);
 
 } // namespace sopang
 
@@ -109,18 +164,30 @@ int handleParams(int argc, const char **argv)
 {
     po::options_description options("Parameters");
     options.add_options()
+       ("batch", "match all patterns in a single pass over the text (exact matching without sources only)")
+       ("breadcrumbs", "when matching with sources, record variants with active states during the text scan so that verification visits only them (exact matching for patterns up to 64 characters)")
+       ("count-only", "report only the number of matching indexes (or the number of matching sources with --full-sources-output)")
        ("dump,d", "dump input file info and throughput to output file (useful for throughput testing)")
        ("dump-indexes,D", "dump resulting indexes (full results) to stdout")
+       ("edit", "use the edit (Levenshtein) distance rather than the Hamming distance for approximate search (max pattern length = 64, max k = 16, matching with sources is not supported)")
+       ("exists-only", "report only whether there is any match, stops at the first match")
+       ("filter", "use a pigeonhole filter for approximate search: k + 1 pattern pieces are matched exactly and only their neighborhoods are verified (Hamming distance without sources only)")
+       ("first-n", po::value<int>(&params.firstN), "report only the first (lowest) n matching indexes, stops after the n-th match")
        ("full-sources-output", "when matching with sources, return all matching source (strain) indexes rather than only verify if the match is correct")
+       ("haplotype-classes", po::value<int>(&params.maxHaplotypeClasses), "maximum number of haplotype classes per block for the haplotype sources engine (default = 16)")
        ("help,h", "display help message")
        ("help-verbose", "display verbose help message")
        ("in-text-file,i", po::value<string>(&params.inTextFile)->required(), "input text file path (positional arg 1)")
        ("in-pattern-file,I", po::value<string>(&params.inPatternFile)->required(), "input pattern file path (positional arg 2)")
        ("in-sources-file,S", po::value<string>(&params.inSourcesFile), "input sources file path")
        ("in-compressed", "parse compressed input text or sources file")
-       ("approx,k", po::value<int>(&params.kApprox), "perform approximate search (Hamming distance) for k errors (preliminary, max pattern length = 12, not compatible with matching with sources)")
+       ("approx,k", po::value<int>(&params.kApprox), "perform approximate search (Hamming distance) for k errors (max pattern length = 128)")
+       ("min-distance", "for approximate search (Hamming distance), report the minimum number of mismatches for each matching index in a single pass for all errors up to k (without sources only)")
        ("out-file,o", po::value<string>(&params.outFile)->default_value("timings.txt"), "output file path")
        ("pattern-count,p", po::value<int>(&params.nPatterns), "maximum number of patterns read from top of the patterns file (non-positive values are ignored)")
+       ("sources-engine", po::value<string>(), "algorithm for matching with sources: backward (verify each candidate match, default), forward (carry sources along the text scan) haplotype (scan linear texts of haplotype classes within blocks of segments) or pbwt (verify each candidate match with a positional BWT of source variants, full sources output uses backward), forward, haplotype and pbwt support exact matching, forward and haplotype for patterns up to 64 characters")
+       ("threads", po::value<int>(&params.nThreads), "number of threads querying different patterns concurrently (not compatible with batch matching)")
+       ("text-threads", po::value<int>(&params.nTextThreads), "number of threads scanning parts of the text for a single pattern (exact matching without sources only)")
        ("version,v", "display version info");
 
     po::positional_options_description positionalOptions;
@@ -170,6 +237,14 @@ int handleParams(int argc, const char **argv)
         return params.errorExitCode;
     }
 
+    if (vm.count("batch"))
+    {
+        params.batchMatch = true;
+    }
+    if (vm.count("count-only"))
+    {
+        params.countOnly = true;
+    }
     if (vm.count("dump"))
     {
         params.dumpToFile = true;
@@ -178,6 +253,26 @@ int handleParams(int argc, const char **argv)
     {
         params.dumpIndexes = true;
     }
+    if (vm.count("breadcrumbs"))
+    {
+        params.breadcrumbs = true;
+    }
+    if (vm.count("edit"))
+    {
+        params.editDistance = true;
+    }
+    if (vm.count("exists-only"))
+    {
+        params.existsOnly = true;
+    }
+    if (vm.count("filter"))
+    {
+        params.approxFilter = true;
+    }
+    if (vm.count("min-distance"))
+    {
+        params.approxMinDistance = true;
+    }
     if (vm.count("full-sources-output"))
     {
         params.fullSourcesOutput = true;
@@ -186,6 +281,103 @@ int handleParams(int argc, const char **argv)
     {
         params.decompressInput = true;
     }
+    if (vm.count("sources-engine"))
+    {
+        const string &engine = vm["sources-engine"].as<string>();
+
+        if (engine == "forward")
+        {
+            params.sourcesEngine = SourcesEngine::Forward;
+        }
+        else if (engine == "haplotype")
+        {
+            params.sourcesEngine = SourcesEngine::Haplotype;
+        }
+        else if (engine == "pbwt")
+        {
+            params.sourcesEngine = SourcesEngine::Pbwt;
+        }
+        else if (engine != "backward")
+        {
+            cerr << "Error: unknown sources engine: " << engine << endl;
+            return params.errorExitCode;
+        }
+    }
+    if (params.nThreads < 1 or params.nTextThreads < 1)
+    {
+        cerr << "Error: the number of threads must be positive" << endl;
+        return params.errorExitCode;
+    }
+    if (vm.count("first-n") and params.firstN < 1)
+    {
+        cerr << "Error: the number of reported matches must be positive" << endl;
+        return params.errorExitCode;
+    }
+    if (static_cast<int>(params.countOnly) + static_cast<int>(params.existsOnly) + static_cast<int>(params.firstN != params.noValue) > 1)
+    {
+        cerr << "Error: only one of --count-only, --exists-only and --first-n can be used" << endl;
+        return params.errorExitCode;
+    }
+    if (params.batchMatch and (params.kApprox > 0 or not params.inSourcesFile.empty()))
+    {
+        cerr << "Error: batch matching is supported only for exact matching without sources" << endl;
+        return params.errorExitCode;
+    }
+    if (params.nTextThreads > 1 and (params.kApprox > 0 or not params.inSourcesFile.empty() or params.batchMatch))
+    {
+        cerr << "Error: text threads are supported only for exact matching without sources and without batch matching" << endl;
+        return params.errorExitCode;
+    }
+    if (params.batchMatch and params.nThreads > 1)
+    {
+        cerr << "Error: batch matching is not supported with multiple pattern threads" << endl;
+        return params.errorExitCode;
+    }
+    if (params.batchMatch and (params.countOnly or params.existsOnly or params.firstN != params.noValue))
+    {
+        cerr << "Error: batch matching does not support count-only, exists-only and first-n modes" << endl;
+        return params.errorExitCode;
+    }
+    if (params.editDistance and params.kApprox <= 0)
+    {
+        cerr << "Error: edit distance requires approximate search (-k)" << endl;
+        return params.errorExitCode;
+    }
+    if (params.editDistance and not params.inSourcesFile.empty())
+    {
+        cerr << "Error: edit distance is not supported for matching with sources" << endl;
+        return params.errorExitCode;
+    }
+    if (params.breadcrumbs and (params.inSourcesFile.empty() or params.kApprox > 0))
+    {
+        cerr << "Error: breadcrumbs require exact matching with sources (-S)" << endl;
+        return params.errorExitCode;
+    }
+    if (params.sourcesEngine != SourcesEngine::Backward and (params.inSourcesFile.empty() or params.kApprox > 0 or params.breadcrumbs))
+    {
+        cerr << "Error: the forward, haplotype and PBWT sources engines require exact matching with sources (-S) without breadcrumbs" << endl;
+        return params.errorExitCode;
+    }
+    if (vm.count("haplotype-classes") and (params.sourcesEngine != SourcesEngine::Haplotype or params.maxHaplotypeClasses < 1))
+    {
+        cerr << "Error: the number of haplotype classes must be positive and requires the haplotype sources engine" << endl;
+        return params.errorExitCode;
+    }
+    if (params.approxFilter and (params.kApprox <= 0 or params.editDistance or not params.inSourcesFile.empty()))
+    {
+        cerr << "Error: the filter requires approximate search (-k) under the Hamming distance without sources" << endl;
+        return params.errorExitCode;
+    }
+    if (params.approxMinDistance and (params.kApprox <= 0 or params.editDistance or params.approxFilter or not params.inSourcesFile.empty()))
+    {
+        cerr << "Error: the minimum distance requires approximate search (-k) under the Hamming distance without the filter and sources" << endl;
+        return params.errorExitCode;
+    }
+    if (params.approxMinDistance and (params.countOnly or params.existsOnly or params.firstN != params.noValue))
+    {
+        cerr << "Error: the minimum distance does not support count-only, exists-only and first-n modes" << endl;
+        return params.errorExitCode;
+    }
 
     return paramsResContinue;
 }
@@ -211,7 +403,7 @@ bool checkInputFiles()
         return false;
     }
 
-    cout << boost::format("Started, using alphabet = \"%1%\" (make sure it matches input files, otherwise undefined behavior occurs!)") % params.alphabet << endl << endl;
+    cout << boost::format("Started, using alphabet = \"%1%\" (make sure it matches input files, otherwise undefined behavior occurs!)") % Params::Alphabet::symbols << endl << endl;
 
     return true;
 }
@@ -223,32 +415,54 @@ int run()
         const string text = readInputText();
         cout << "Parsing segments..." << endl;
 
-        int nSegments = 0;
-        int *segmentSizes = nullptr;
-
-        const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
-        cout << "Parsed #segments = " << nSegments << endl;
+        const EdText edText = parsing::parseEdText<Params::Alphabet>(text);
+        cout << "Parsed #segments = " << edText.nSegments() << endl;
 
-        if (nSegments == 0)
+        if (edText.nSegments() == 0)
         {
             throw runtime_error("cannot run for empty segments");
         }
 
         vector<string> patterns = readPatterns();
-
-        SegmentData segmentData{ segments, nSegments, segmentSizes };
-        Sopang::SourceMap sourceMap;
+        AlphabetSopang::SourceMap sourceMap;
 
         int sourceCount = 0;
 
         if (not params.inSourcesFile.empty())
         {
-            const vector<vector<Sopang::SourceSet>> sources = readSources(nSegments, segmentSizes, sourceCount);
-            sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
+            vector<vector<AlphabetSopang::SourceSet>> sources = readSources(edText, sourceCount);
+
+            vector<int> segmentSizes(edText.nSegments());
+
+            for (int iS = 0; iS < edText.nSegments(); ++iS)
+            {
+                segmentSizes[iS] = edText.segmentSize(iS);
+            }
+
+            sourceMap = parsing::sourcesToSourceMap(edText.nSegments(), segmentSizes.data(), move(sources));
+        }
+
+        SourcesIndexes sourcesIndexes;
+
+        if (params.sourcesEngine == SourcesEngine::Haplotype)
+        {
+            const int maxClasses = (params.maxHaplotypeClasses == params.noValue) ? AlphabetSopang::HaplotypeIndex::defaultMaxClasses : params.maxHaplotypeClasses;
+            sourcesIndexes.haplotypeIndex = AlphabetSopang::HaplotypeIndex(edText, sourceMap, sourceCount, maxClasses);
+
+            const AlphabetSopang::HaplotypeIndex &haplotypeIndex = sourcesIndexes.haplotypeIndex;
+            cout << boost::format("Built haplotype blocks, #blocks = %1%, #classes = %2%, MB = %3%")
+                % haplotypeIndex.nBlocks() % haplotypeIndex.nClasses() % (haplotypeIndex.sizeInBytes() / 1'000'000.0) << endl;
+        }
+        else if (params.sourcesEngine == SourcesEngine::Pbwt and not params.fullSourcesOutput)
+        {
+            sourcesIndexes.pbwtIndex = AlphabetSopang::PbwtIndex(edText, sourceMap, sourceCount);
+
+            const AlphabetSopang::PbwtIndex &pbwtIndex = sourcesIndexes.pbwtIndex;
+            cout << boost::format("Built PBWT index, #columns = %1%, #runs = %2%, MB = %3% (source map MB = %4%)")
+                % pbwtIndex.nColumns() % pbwtIndex.nRuns() % (pbwtIndex.sizeInBytes() / 1'000'000.0) % (sourceMap.sizeInBytes() / 1'000'000.0) << endl;
         }
 
-        runSopang(segmentData, sourceMap, sourceCount, patterns);
-        clearMemory(segmentData);
+        runSopang(edText, sourceMap, sourcesIndexes, sourceCount, patterns);
     }
     catch (const exception &e)
     {
@@ -288,6 +502,7 @@ vector<string> readPatterns()
     cout << "Read file: " << params.inPatternFile << endl;
 
     vector<string> patterns = parsing::parsePatterns(patternsStr);
+    parsing::validatePatterns<Params::Alphabet>(patterns);
 
     if (params.nPatterns > 0 and static_cast<size_t>(params.nPatterns) < patterns.size())
     {
@@ -301,15 +516,66 @@ vector<string> readPatterns()
         throw runtime_error("cannot run for empty patterns");
     }
 
+    if (params.kApprox > 0 and params.editDistance)
+    {
+        if (params.kApprox > AlphabetSopang::maxEditErrors)
+        {
+            throw runtime_error("too many errors for edit distance search, max = " + to_string(AlphabetSopang::maxEditErrors));
+        }
+
+        for (const string &pattern : patterns)
+        {
+            if (pattern.size() > AlphabetSopang::maxPatternEditSize)
+            {
+                throw runtime_error("pattern too long for edit distance search, max length = " + to_string(AlphabetSopang::maxPatternEditSize));
+            }
+        }
+    }
+    else if (params.sourcesEngine == SourcesEngine::Forward)
+    {
+        for (const string &pattern : patterns)
+        {
+            if (pattern.size() > AlphabetSopang::maxPatternSourcesForwardSize)
+            {
+                throw runtime_error("pattern too long for the forward sources engine, max length = " + to_string(AlphabetSopang::maxPatternSourcesForwardSize));
+            }
+        }
+    }
+    else if (params.sourcesEngine == SourcesEngine::Haplotype)
+    {
+        for (const string &pattern : patterns)
+        {
+            if (pattern.size() > AlphabetSopang::maxPatternHaplotypeSize)
+            {
+                throw runtime_error("pattern too long for the haplotype sources engine, max length = " + to_string(AlphabetSopang::maxPatternHaplotypeSize));
+            }
+        }
+    }
+    else if (params.kApprox > 0)
+    {
+        if (params.kApprox > AlphabetSopang::maxApproxErrors)
+        {
+            throw runtime_error("too many errors for approximate search, max = " + to_string(AlphabetSopang::maxApproxErrors));
+        }
+
+        for (const string &pattern : patterns)
+        {
+            if (pattern.size() > AlphabetSopang::maxPatternApproxSize)
+            {
+                throw runtime_error("pattern too long for approximate search, max length = " + to_string(AlphabetSopang::maxPatternApproxSize));
+            }
+        }
+    }
+
     return patterns;
 }
 
-vector<vector<Sopang::SourceSet>> readSources(int nSegments, const int *segmentSizes, int &sourceCount)
+vector<vector<AlphabetSopang::SourceSet>> readSources(const EdText &edText, int &sourceCount)
 {
     string sourcesStr = helpers::readFile(params.inSourcesFile);
     cout << "Read file: " << params.inSourcesFile << endl;
 
-    vector<vector<Sopang::SourceSet>> sources;
+    vector<vector<AlphabetSopang::SourceSet>> sources;
 
     if (params.decompressInput)
     {
@@ -329,6 +595,18 @@ vector<vector<Sopang::SourceSet>> readSources(int nSegments, const int *segmentS
 
     cout << "Source count = " << sourceCount << endl;
 
+    size_t sourcesSizeBytes = 0;
+
+    for (const vector<AlphabetSopang::SourceSet> &segment : sources)
+    {
+        for (const AlphabetSopang::SourceSet &variant : segment)
+        {
+            sourcesSizeBytes += variant.sizeInBytes();
+        }
+    }
+
+    cout << boost::format("Source sets size = %.2f MB") % (static_cast<double>(sourcesSizeBytes) / 1'000'000.0) << endl;
+
     if (sources.empty())
     {
         throw runtime_error("cannot run for empty sources");
@@ -337,23 +615,23 @@ vector<vector<Sopang::SourceSet>> readSources(int nSegments, const int *segmentS
     // We check whether the source counts match the segments in text.
     size_t sourceIdx = 0;
 
-    for (int segmentIdx = 0; segmentIdx < nSegments; ++segmentIdx)
+    for (int segmentIdx = 0; segmentIdx < edText.nSegments(); ++segmentIdx)
     {
-        if (segmentSizes[segmentIdx] == 1)
+        if (edText.segmentSize(segmentIdx) == 1)
         {
             continue;
         }
 
-        if (static_cast<size_t>(segmentSizes[segmentIdx]) != sources[sourceIdx].size())
+        if (static_cast<size_t>(edText.segmentSize(segmentIdx)) != sources[sourceIdx].size())
         {
             throw runtime_error("source segment variant count does not match text segment variant count, source segment index = "
                 + to_string(sourceIdx));
         }
 
         // We check whether all sources are present for the current segment.
-        Sopang::SourceSet sourcesForSegment(sourceCount);
+        AlphabetSopang::SourceSet sourcesForSegment(sourceCount);
 
-        for (const Sopang::SourceSet &sourcesForVariant : sources[sourceIdx])
+        for (const AlphabetSopang::SourceSet &sourcesForVariant : sources[sourceIdx])
         {
             sourcesForSegment |= sourcesForVariant;
         }
@@ -380,46 +658,50 @@ vector<vector<Sopang::SourceSet>> readSources(int nSegments, const int *segmentS
     return sources;
 }
 
-void runSopang(const SegmentData &segmentData,
-    const Sopang::SourceMap &sourceMap,
+void runSopang(const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
     int sourceCount,
     const vector<string> &patterns)
 {
-    assert(segmentData.nSegments > 0);
-    assert(segmentData.segments != nullptr and segmentData.segmentSizes != nullptr);
+    assert(edText.nSegments() > 0);
     assert(patterns.size() > 0);
 
     int textSize;
     double textSizeMB;
 
-    calcTextSize(segmentData, textSize, textSizeMB);
+    calcTextSize(edText, textSize, textSizeMB);
     cout << boost::format("EDS length = %1%, EDS size = %2% (%3% MB)") 
-        % segmentData.nSegments % textSize % textSizeMB << endl;
+        % edText.nSegments() % textSize % textSizeMB << endl;
 
     vector<double> elapsedSecVec;
 
-    for (size_t iP = 0; iP < patterns.size(); ++iP)
+    if (params.batchMatch)
     {
-        const double percProg = static_cast<double>(iP + 1) * 100.0 / patterns.size();
-        const string pattern = patterns[iP];
-
-        string msg;
+        cout << endl << "Querying #patterns = " << patterns.size() << " in a single pass" << endl;
+        elapsedSecVec.assign(patterns.size(), measureBatch(edText, patterns));
+    }
+    else if (params.nThreads > 1)
+    {
+        cout << endl << "Querying #patterns = " << patterns.size() << " using #threads = " << params.nThreads << endl;
+        elapsedSecVec = measureParallel(edText, sourceMap, sourcesIndexes, sourceCount, patterns);
+    }
+    else
+    {
+        // A single instance (together with its scratch buffer sized for the loaded text) is reused for all patterns.
+        AlphabetSopang sopang;
+        sopang.reserveScratch(edText.maxSegmentSize());
+        sopang.setBreadcrumbs(params.breadcrumbs);
 
-        if (params.kApprox > 0)
+        for (size_t iP = 0; iP < patterns.size(); ++iP)
         {
-            msg = (boost::format("Querying pattern %d/%d (%.2f) = \"%s\" for k = %d") %
-                (iP + 1) % patterns.size() % percProg % pattern % params.kApprox).str();
-        }
-        else
-        {
-            msg = (boost::format("Querying pattern %d/%d (%.2f%%) = \"%s\"") %
-                (iP + 1) % patterns.size() % percProg % pattern).str();
-        }
+            cout << endl << calcQueryMessage(iP, patterns) << endl;
 
-        cout << endl << msg << endl;
+            const QueryResult result = measure(sopang, edText, sourceMap, sourcesIndexes, sourceCount, patterns[iP]);
+            reportResult(result);
 
-        const double elapsedSec = measure(segmentData, sourceMap, sourceCount, pattern);
-        elapsedSecVec.push_back(elapsedSec);
+            elapsedSecVec.push_back(result.elapsedSec);
+        }
     }
 
     if (params.dumpToFile)
@@ -428,22 +710,22 @@ void runSopang(const SegmentData &segmentData,
     }
 }
 
-void calcTextSize(const SegmentData &segmentData, int &textSize, double &textSizeMB)
+void calcTextSize(const EdText &edText, int &textSize, double &textSizeMB)
 {
     textSize = 0;
 
-    for (int iS = 0; iS < segmentData.nSegments; ++iS)
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
     {
-        for (int iSS = 0; iSS < segmentData.segmentSizes[iS]; ++iSS)
+        for (int iSS = 0; iSS < edText.segmentSize(iS); ++iSS)
         {
-            if (segmentData.segments[iS][iSS].empty())
+            if (edText.variantSize(iS, iSS) == 0)
             {
                 // Empty segment is regarded as having size 1 when counted towards the total size.
                 textSize += 1;
             }
             else
             {
-                textSize += segmentData.segments[iS][iSS].size();
+                textSize += edText.variantSize(iS, iSS);
             }
         }
     }
@@ -451,101 +733,427 @@ void calcTextSize(const SegmentData &segmentData, int &textSize, double &textSiz
     textSizeMB = static_cast<double>(textSize) / 1'000'000.0;
 }
 
-double measure(const SegmentData &segmentData,
-    const Sopang::SourceMap &sourceMap,
+string calcQueryMessage(size_t iP, const vector<string> &patterns)
+{
+    const double percProg = static_cast<double>(iP + 1) * 100.0 / patterns.size();
+
+    if (params.kApprox > 0)
+    {
+        return (boost::format("Querying pattern %d/%d (%.2f) = \"%s\" for k = %d") %
+            (iP + 1) % patterns.size() % percProg % patterns[iP] % params.kApprox).str();
+    }
+
+    return (boost::format("Querying pattern %d/%d (%.2f%%) = \"%s\"") %
+        (iP + 1) % patterns.size() % percProg % patterns[iP]).str();
+}
+
+QueryResult measure(AlphabetSopang &sopang,
+    const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
     int sourceCount,
     const string &pattern)
 {
-    unordered_set<int> res;
-    clock_t start, end;
+    QueryResult result;
 
+    if (not sourceMap.empty() and params.fullSourcesOutput)
     {
-        Sopang sopang(params.alphabet);
+        if (params.existsOnly or params.firstN != params.noValue)
+        {
+            throw runtime_error("full sources output supports only the count-only mode");
+        }
 
-        if (params.kApprox > 0)
+        if (params.kApprox > 0 and params.countOnly)
         {
-            if (not sourceMap.empty())
+            throw runtime_error("full sources output in the count-only mode is not supported for approximate matching");
+        }
+
+        chrono::steady_clock::time_point start, end;
+
+        if (params.countOnly)
+        {
+            // The PBWT engine only verifies matches, counting sources falls back to the backward engine.
+            if (params.sourcesEngine == SourcesEngine::Haplotype)
             {
-                throw runtime_error("matching with sources is not supported for approximate matching");
+                start = chrono::steady_clock::now();
+                result.nMatchingSources = sopang.countMatchingSourcesHaplotype(
+                    edText,
+                    sourcesIndexes.haplotypeIndex,
+                    pattern);
+                end = chrono::steady_clock::now();
+            }
+            else if (params.sourcesEngine == SourcesEngine::Forward)
+            {
+                start = chrono::steady_clock::now();
+                result.nMatchingSources = sopang.countMatchingSourcesForward(
+                    edText,
+                    sourceMap,
+                    sourceCount,
+                    pattern);
+                end = chrono::steady_clock::now();
+            }
+            else
+            {
+                start = chrono::steady_clock::now();
+                result.nMatchingSources = sopang.countMatchingSources(
+                    edText,
+                    sourceMap,
+                    sourceCount,
+                    pattern);
+                end = chrono::steady_clock::now();
             }
-
-            start = std::clock();
-            res = sopang.matchApprox(
-                segmentData.segments,
-                segmentData.nSegments,
-                segmentData.segmentSizes,
-                pattern,
-                params.kApprox);
-            end = std::clock();
         }
         else
         {
-            if (sourceMap.empty())
+            unordered_map<int, AlphabetSopang::SourceSet> fullSourceMatches;
+
+            if (params.kApprox > 0)
+            {
+                start = chrono::steady_clock::now();
+                fullSourceMatches = sopang.matchApproxWithSources(
+                    edText,
+                    sourceMap,
+                    sourceCount,
+                    pattern,
+                    params.kApprox);
+                end = chrono::steady_clock::now();
+            }
+            // The PBWT engine only verifies matches, full sources output falls back to the backward engine.
+            else if (params.sourcesEngine == SourcesEngine::Haplotype)
             {
-                start = std::clock();
-                res = sopang.match(
-                    segmentData.segments,
-                    segmentData.nSegments,
-                    segmentData.segmentSizes,
+                start = chrono::steady_clock::now();
+                fullSourceMatches = sopang.matchWithSourcesHaplotype(
+                    edText,
+                    sourcesIndexes.haplotypeIndex,
                     pattern);
-                end = std::clock();
+                end = chrono::steady_clock::now();
+            }
+            else if (params.sourcesEngine == SourcesEngine::Forward)
+            {
+                start = chrono::steady_clock::now();
+                fullSourceMatches = sopang.matchWithSourcesForward(
+                    edText,
+                    sourceMap,
+                    sourceCount,
+                    pattern);
+                end = chrono::steady_clock::now();
             }
             else
             {
-                if (params.fullSourcesOutput)
-                {
-                    start = std::clock();
-                    const auto fullSourceMatches = sopang.matchWithSources(
-                        segmentData.segments,
-                        segmentData.nSegments,
-                        segmentData.segmentSizes,
-                        sourceMap,
-                        sourceCount,
-                        pattern);
-                    end = std::clock();
-
-                    for (const auto &kv : map<int, Sopang::SourceSet>(fullSourceMatches.begin(), fullSourceMatches.end())) // ordered map
-                    {
-                        res.insert(kv.first);
-
-                        if (params.dumpIndexes)
-                        {
-                            dumpSources(kv.first, kv.second);
-                        }
-                    }
-                }
-                else
-                {
-                    start = std::clock();
-                    res = sopang.matchWithSourcesVerify(
-                        segmentData.segments,
-                        segmentData.nSegments,
-                        segmentData.segmentSizes,
-                        sourceMap,
-                        sourceCount,
-                        pattern);
-                    end = std::clock();
-                }
+                start = chrono::steady_clock::now();
+                fullSourceMatches = sopang.matchWithSources(
+                    edText,
+                    sourceMap,
+                    sourceCount,
+                    pattern);
+                end = chrono::steady_clock::now();
             }
+
+            result.sources.insert(fullSourceMatches.begin(), fullSourceMatches.end()); // ordered map
+
+            for (const auto &kv : result.sources)
+            {
+                result.indexes.push_back(kv.first);
+            }
+
+            result.nResults = static_cast<int>(result.indexes.size());
+        }
+
+        result.elapsedSec = chrono::duration<double>(end - start).count();
+    }
+    else if (params.approxMinDistance)
+    {
+        chrono::steady_clock::time_point start, end;
+
+        start = chrono::steady_clock::now();
+        const unordered_map<int, int> distances = sopang.matchApproxMinDistance(
+            edText,
+            pattern,
+            params.kApprox);
+        end = chrono::steady_clock::now();
+
+        result.distances.insert(distances.begin(), distances.end()); // ordered map
+
+        for (const auto &kv : result.distances)
+        {
+            result.indexes.push_back(kv.first);
         }
+
+        result.nResults = static_cast<int>(result.indexes.size());
+        result.elapsedSec = chrono::duration<double>(end - start).count();
+    }
+    else if (params.countOnly)
+    {
+        CountSink sink;
+
+        result.elapsedSec = measureSink(sopang, edText, sourceMap, sourcesIndexes, sourceCount, pattern, sink);
+        result.nResults = sink.count;
+    }
+    else if (params.existsOnly)
+    {
+        ExistsSink sink;
+
+        result.elapsedSec = measureSink(sopang, edText, sourceMap, sourcesIndexes, sourceCount, pattern, sink);
+        result.nResults = sink.exists ? 1 : 0;
+    }
+    else if (params.firstN != params.noValue)
+    {
+        FirstNSink sink(params.firstN);
+
+        result.elapsedSec = measureSink(sopang, edText, sourceMap, sourcesIndexes, sourceCount, pattern, sink);
+        result.indexes = move(sink.indexes);
+        result.nResults = static_cast<int>(result.indexes.size());
+    }
+    else
+    {
+        SortedVectorSink sink;
+
+        result.elapsedSec = measureSink(sopang, edText, sourceMap, sourcesIndexes, sourceCount, pattern, sink);
+        result.indexes = move(sink.indexes);
+        result.nResults = static_cast<int>(result.indexes.size());
+    }
+
+    return result;
+}
+
+template<typename Sink>
+double measureSink(AlphabetSopang &sopang,
+    const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
+    int sourceCount,
+    const string &pattern,
+    Sink &sink)
+{
+    chrono::steady_clock::time_point start, end;
+
+    if (params.kApprox > 0 and params.editDistance)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchEdit(
+            edText,
+            pattern,
+            params.kApprox,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (params.kApprox > 0 and not sourceMap.empty())
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchApproxWithSourcesVerify(
+            edText,
+            sourceMap,
+            sourceCount,
+            pattern,
+            params.kApprox,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (params.kApprox > 0 and params.approxFilter)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchApproxFiltered(
+            edText,
+            pattern,
+            params.kApprox,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (params.kApprox > 0)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchApprox(
+            edText,
+            pattern,
+            params.kApprox,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (not sourceMap.empty() and params.sourcesEngine == SourcesEngine::Pbwt)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchWithSourcesVerifyPbwt(
+            edText,
+            sourcesIndexes.pbwtIndex,
+            pattern,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (not sourceMap.empty() and params.sourcesEngine == SourcesEngine::Haplotype)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchWithSourcesVerifyHaplotype(
+            edText,
+            sourcesIndexes.haplotypeIndex,
+            pattern,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (not sourceMap.empty() and params.sourcesEngine == SourcesEngine::Forward)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchWithSourcesVerifyForward(
+            edText,
+            sourceMap,
+            sourceCount,
+            pattern,
+            sink);
+        end = chrono::steady_clock::now();
     }
+    else if (not sourceMap.empty())
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchWithSourcesVerify(
+            edText,
+            sourceMap,
+            sourceCount,
+            pattern,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else if (params.nTextThreads > 1)
+    {
+        start = chrono::steady_clock::now();
+        sopang.matchParallel(
+            edText,
+            pattern,
+            params.nTextThreads,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+    else
+    {
+        start = chrono::steady_clock::now();
+        sopang.match(
+            edText,
+            pattern,
+            sink);
+        end = chrono::steady_clock::now();
+    }
+
+    return chrono::duration<double>(end - start).count();
+}
+
+vector<double> measureParallel(const EdText &edText,
+    const AlphabetSopang::SourceMap &sourceMap,
+    const SourcesIndexes &sourcesIndexes,
+    int sourceCount,
+    const vector<string> &patterns)
+{
+    ThreadPool pool(params.nThreads);
+    vector<unique_ptr<AlphabetSopang>> sopangs;
+
+    for (int iW = 0; iW < pool.size(); ++iW)
+    {
+        sopangs.push_back(make_unique<AlphabetSopang>());
+        sopangs.back()->reserveScratch(edText.maxSegmentSize());
+        sopangs.back()->setBreadcrumbs(params.breadcrumbs);
+    }
+
+    vector<QueryResult> results(patterns.size());
+
+    pool.run(static_cast<int>(patterns.size()), [&](int iP, int iW) {
+        results[iP] = measure(*sopangs[iW], edText, sourceMap, sourcesIndexes, sourceCount, patterns[iP]);
+    });
+
+    vector<double> elapsedSecVec;
+
+    for (size_t iP = 0; iP < patterns.size(); ++iP)
+    {
+        cout << endl << calcQueryMessage(iP, patterns) << endl;
+        reportResult(results[iP]);
+
+        elapsedSecVec.push_back(results[iP].elapsedSec);
+    }
+
+    return elapsedSecVec;
+}
 
+void reportResult(const QueryResult &result)
+{
     // Make sure that the number of results is printed in order to
     // prevent the compiler from overoptimizing unused results.
-    cout << "#results = " << res.size() << endl;
+    if (result.nMatchingSources != params.noValue)
+    {
+        cout << "#matching sources = " << result.nMatchingSources << endl;
+    }
+    else
+    {
+        cout << "#results = " << result.nResults << endl;
+    }
+
+    if (params.approxMinDistance)
+    {
+        // The number of results for a smaller k is the number of indexes with the distance at most k.
+        vector<int> distanceCounts(params.kApprox + 1, 0);
+
+        for (const auto &kv : result.distances)
+        {
+            distanceCounts[kv.second] += 1;
+        }
+
+        cout << "#indexes per minimum distance (0 to k) = ";
+
+        for (const int count : distanceCounts)
+        {
+            cout << count << " ";
+        }
+
+        cout << endl;
+    }
 
     if (params.dumpIndexes)
     {
-        dumpIndexes(res);
+        for (const auto &kv : result.sources)
+        {
+            dumpSources(kv.first, kv.second);
+        }
+
+        for (const auto &kv : result.distances)
+        {
+            cout << kv.first << " -> " << kv.second << endl;
+        }
+
+        dumpIndexes(result.indexes);
+    }
+
+    if (result.elapsedSec == 0.0)
+    {
+        cerr << "[ERROR] Elapsed is 0" << endl;
+    }
+}
+
+double measureBatch(const EdText &edText, const vector<string> &patterns)
+{
+    vector<SortedVectorSink> res(patterns.size());
+    chrono::steady_clock::time_point start, end;
+
+    {
+        AlphabetSopang sopang;
+
+        start = chrono::steady_clock::now();
+        sopang.matchBatch(edText, patterns, res);
+        end = chrono::steady_clock::now();
     }
 
-    double elapsedSec = (end - start) / static_cast<double>(CLOCKS_PER_SEC);
+    for (size_t iP = 0; iP < patterns.size(); ++iP)
+    {
+        cout << endl << boost::format("Pattern %d/%d = \"%s\"") % (iP + 1) % patterns.size() % patterns[iP] << endl;
+        cout << "#results = " << res[iP].indexes.size() << endl;
+
+        if (params.dumpIndexes)
+        {
+            dumpIndexes(res[iP].indexes);
+        }
+    }
+
+    const double elapsedSec = chrono::duration<double>(end - start).count();
     if (elapsedSec == 0.0)
     {
         cerr << "[ERROR] Elapsed is 0" << endl;
     }
 
-    return elapsedSec;
+    return elapsedSec / patterns.size();
 }
 
 void dumpMedians(const vector<double> &elapsedSecVec, double textSizeMB)
@@ -562,7 +1170,7 @@ void dumpMedians(const vector<double> &elapsedSecVec, double textSizeMB)
     cout << endl << "Dumped to: " << params.outFile << " ([input file name] [input text size MB] [median elapsed sec] [median throughput MB/s])" << endl;
 }
 
-void dumpSources(int index, const Sopang::SourceSet &sources)
+void dumpSources(int index, const AlphabetSopang::SourceSet &sources)
 {
     cout << index << " -> ";
 
@@ -581,12 +1189,12 @@ void dumpSources(int index, const Sopang::SourceSet &sources)
     cout << endl;
 }
 
-void dumpIndexes(const unordered_set<int> &indexes)
+void dumpIndexes(const vector<int> &indexes)
 {
     if (indexes.empty())
         return;
 
-    for (const int index : set<int>(indexes.begin(), indexes.end())) // ordered set
+    for (const int index : indexes)
     {
         cout << index << " ";
     }
@@ -594,20 +1202,4 @@ void dumpIndexes(const unordered_set<int> &indexes)
     cout << endl;
 }
 
-void clearMemory(SegmentData &segmentData)
-{
-    assert(segmentData.nSegments > 0);
-    assert(segmentData.segments != nullptr and segmentData.segmentSizes != nullptr);
-
-    for (int iSeg = 0; iSeg < segmentData.nSegments; ++iSeg)
-    {
-        delete[] segmentData.segments[iSeg];
-    }
-
-    delete[] segmentData.segments;
-    delete[] segmentData.segmentSizes;
-
-    cout << endl << "Cleared memory" << endl;
-}
-
 } // namespace sopang
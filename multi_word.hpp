@@ -0,0 +1,130 @@
+#ifndef MULTI_WORD_HPP
+#define MULTI_WORD_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace sopang
+{
+
+/** Bit vector of N 64-bit words used as a Shift-Or state for patterns longer than a single word.
+ * Bit i is stored in words[i / 64], the least significant word comes first. */
+template<size_t N>
+class MultiWord
+{
+public:
+    /** Returns a vector with all bits set to [bit]. */
+    static MultiWord filled(bool bit);
+
+    /** Shift-Or step: shifts left by one (inserting 0) and ORs with [mask]. */
+    void shiftOr(const MultiWord &mask);
+
+    MultiWord &operator&=(const MultiWord &other);
+
+    bool test(size_t n) const;
+    void reset(size_t n);
+
+private:
+    uint64_t words[N];
+};
+
+template<size_t N>
+MultiWord<N> MultiWord<N>::filled(bool bit)
+{
+    MultiWord ret;
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        ret.words[i] = bit ? ~0x0ULL : 0x0ULL;
+    }
+
+    return ret;
+}
+
+template<size_t N>
+void MultiWord<N>::shiftOr(const MultiWord &mask)
+{
+    // We go from the most significant word so that the carried bit is taken from the unshifted lower word.
+    for (size_t i = N - 1; i > 0; --i)
+    {
+        words[i] = ((words[i] << 1) | (words[i - 1] >> 63)) | mask.words[i];
+    }
+
+    words[0] = (words[0] << 1) | mask.words[0];
+}
+
+template<size_t N>
+MultiWord<N> &MultiWord<N>::operator&=(const MultiWord &other)
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        words[i] &= other.words[i];
+    }
+
+    return *this;
+}
+
+template<size_t N>
+bool MultiWord<N>::test(size_t n) const
+{
+    assert(n < N * 64);
+    return (words[n / 64] & (0x1ULL << (n % 64))) != 0x0ULL;
+}
+
+template<size_t N>
+void MultiWord<N>::reset(size_t n)
+{
+    assert(n < N * 64);
+    words[n / 64] &= (~(0x1ULL << (n % 64)));
+}
+
+#ifdef __SIZEOF_INT128__
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+/** Two words are handled as a single 128-bit integer, the compiler emits a shift pair without the explicit carry. */
+template<>
+class MultiWord<2>
+{
+public:
+    static MultiWord filled(bool bit)
+    {
+        MultiWord ret;
+        ret.word = bit ? ~static_cast<uint128_t>(0) : 0;
+
+        return ret;
+    }
+
+    void shiftOr(const MultiWord &mask)
+    {
+        word = (word << 1) | mask.word;
+    }
+
+    MultiWord &operator&=(const MultiWord &other)
+    {
+        word &= other.word;
+        return *this;
+    }
+
+    bool test(size_t n) const
+    {
+        assert(n < 128);
+        return (word & (static_cast<uint128_t>(1) << n)) != 0;
+    }
+
+    void reset(size_t n)
+    {
+        assert(n < 128);
+        word &= (~(static_cast<uint128_t>(1) << n));
+    }
+
+private:
+    uint128_t word;
+};
+
+#endif // __SIZEOF_INT128__
+
+} // namespace sopang
+
+#endif // MULTI_WORD_HPP
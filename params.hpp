@@ -1,20 +1,35 @@
 #ifndef PARAMS_HPP
 #define PARAMS_HPP
 
+#include "alphabet.hpp"
+
 #include <string>
 
 namespace sopang
 {
 
+/** Algorithm used for matching with sources. */
+enum class SourcesEngine
+{
+    /** Sources are verified backwards from each candidate match found by the Shift-Or scan. */
+    Backward,
+    /** Sources of active prefixes are carried along with the Shift-Or state during a single forward scan. */
+    Forward,
+    /** Linear texts of haplotype classes within blocks of segments are scanned, see haplotype_index.hpp. */
+    Haplotype,
+    /** Candidates are verified backwards with a positional BWT of source variants rather than source sets, see pbwt_index.hpp. */
+    Pbwt
+};
+
 struct Params
 {
     /* 
      *** COMPILE-TIME PARAMS
      */
 
-    /** A set of symbols occurring in input (ED) text file or input pattern file.
+    /** A set of symbols occurring in input (ED) text file or input pattern file, see alphabet.hpp.
       * Restricted to DNA characters, matches the output of the data generation tools from the scripts folder. */
-    const std::string alphabet = "ACGTN";
+    using Alphabet = DnaAlphabet;
 
     /*
      *** COMMAND-LINE PARAMS
@@ -22,20 +37,45 @@ struct Params
 
     // These parameters are set by handleParams() in main.cpp after parsing command line args.
 
+    /** Match all patterns in a single pass over the text. Cmd arg --batch. */
+    bool batchMatch = false;
+    /** Record variants with active states during the forward scan and verify sources only through them. Cmd arg --breadcrumbs. */
+    bool breadcrumbs = false;
+    /** Report only the number of matching indexes, or the number of matching sources together with fullSourcesOutput. Cmd arg --count-only. */
+    bool countOnly = false;
     /** Decompress input files (zstd lib compression and custom sources file format). */
     bool decompressInput = false;
+    /** Use the edit (Levenshtein) distance rather than the Hamming distance for approximate search. Cmd arg --edit. */
+    bool editDistance = false;
+    /** Use the pigeonhole filter for approximate search under the Hamming distance. Cmd arg --filter. */
+    bool approxFilter = false;
+    /** Report the minimum number of mismatches for each matching index, for all k up to the one given with -k. Cmd arg --min-distance. */
+    bool approxMinDistance = false;
     /** Dump input file info and throughput to output file (outFile). Cmd arg -d. */
     bool dumpToFile = false;
     /** Dump resulting indexes (full results) to stdout. Cmd arg -D. */
     bool dumpIndexes = false;
+    /** Report only whether there is any match, the search stops at the first match. Cmd arg --exists-only. */
+    bool existsOnly = false;
     /** When matching with sources, return all matching source (strain) indexes
      * rather than only verify if the match is correct. */
     bool fullSourcesOutput = false;
 
+    /** Algorithm used for matching with sources. Cmd arg --sources-engine. */
+    SourcesEngine sourcesEngine = SourcesEngine::Backward;
+
     /** Number of errors for approximate search (Hamming distance). noValue = perform exact search. Cmd arg -k. */
     int kApprox = noValue;
+    /** Report only the first (lowest) n matching indexes, the search stops after the n-th match. noValue = report all matches. Cmd arg --first-n. */
+    int firstN = noValue;
+    /** Maximum number of haplotype classes per block for the haplotype sources engine. noValue = use the default. Cmd arg --haplotype-classes. */
+    int maxHaplotypeClasses = noValue;
     /** Maximum number of patterns read from top of the patterns file. noValue = ignore the pattern count limit. Cmd arg -p. */
     int nPatterns = noValue;
+    /** Number of worker threads querying different patterns concurrently, 1 = sequential queries. Cmd arg --threads. */
+    int nThreads = 1;
+    /** Number of threads scanning the text for a single pattern, 1 = sequential scan. Cmd arg --text-threads. */
+    int nTextThreads = 1;
 
     /** Input text file path (positional arg 1). */
     std::string inTextFile;
@@ -6,6 +6,7 @@
 #include <boost/format.hpp>
 
 #include <cassert>
+#include <limits>
 #include <stdexcept>
 
 using namespace std;
@@ -106,6 +107,117 @@ const string *const *parseTextArray(string text, int *nSegments, int **segmentSi
     return const_cast<const string *const *>(res);
 }
 
+template<typename Alphabet>
+EdText parseEdText(string text)
+{
+    boost::trim(text);
+
+    EdText res;
+    bool inSegment = false;
+
+    int curSegmentSize = 0; // Number of closed variants in the current non-deterministic segment.
+    bool inString = false; // Whether a deterministic segment is being built.
+
+    for (size_t i = 0; text[i] != '\0'; ++i)
+    {
+        if (text[i] != '{' and text[i] != '}') // Inside a string or a segment: comma or string character.
+        {
+            if (not inSegment)
+            {
+                if (text[i] == ',')
+                {
+                    throw runtime_error("bad input text formatting: comma outside a segment: char index = " + to_string(i));
+                }
+                if (not Alphabet::isValid(text[i]))
+                {
+                    throw runtime_error("symbol outside the alphabet in input text: char index = " + to_string(i));
+                }
+
+                res.appendChar(text[i]);
+                inString = true;
+            }
+            else
+            {
+                if (text[i] == ',')
+                {
+                    res.closeVariant();
+                    curSegmentSize += 1;
+                }
+                else
+                {
+                    if (not Alphabet::isValid(text[i]))
+                    {
+                        throw runtime_error("symbol outside the alphabet in input text: char index = " + to_string(i));
+                    }
+
+                    res.appendChar(text[i]);
+                }
+            }
+        }
+        else if (text[i] == '{') // Segment start.
+        {
+            assert(not inSegment and curSegmentSize == 0);
+
+            if (inString) // If we enter the non-deterministic segment from a deterministic segment (string).
+            {
+                res.closeVariant();
+                res.closeSegment();
+
+                inString = false;
+            }
+
+            inSegment = true;
+        }
+        else // Segment end.
+        {
+            assert(text[i] == '}');
+            assert(inSegment == true and curSegmentSize >= 1);
+
+            if (curSegmentSize == 0)
+            {
+                throw runtime_error("non-deterministic segment cannot be empty: char index = " + to_string(i));
+            }
+
+            res.closeVariant();
+            res.closeSegment();
+
+            curSegmentSize = 0;
+            inSegment = false;
+        }
+    }
+
+    if (inString) // If the file ended with a deterministic segment.
+    {
+        assert(not inSegment and curSegmentSize == 0);
+
+        res.closeVariant();
+        res.closeSegment();
+    }
+
+    return res;
+}
+
+template<typename Alphabet>
+void validatePatterns(const vector<string> &patterns)
+{
+    for (size_t iP = 0; iP < patterns.size(); ++iP)
+    {
+        for (const char c : patterns[iP])
+        {
+            if (not Alphabet::isValid(c))
+            {
+                throw runtime_error("symbol outside the alphabet in pattern: pattern index = " + to_string(iP));
+            }
+        }
+    }
+}
+
+template EdText parseEdText<DnaAlphabet>(string text);
+template EdText parseEdText<ProteinAlphabet>(string text);
+
+template void validatePatterns<DnaAlphabet>(const vector<string> &patterns);
+template void validatePatterns<ProteinAlphabet>(const vector<string> &patterns);
+
 vector<string> parsePatterns(string patternsStr)
 {
     boost::trim(patternsStr);
@@ -174,32 +286,25 @@ void handleSourceNumberEnd(string &curNumber, Sopang::SourceSet &curVariant, int
 void handleSourceVariantEnd(Sopang::SourceSet &curVariant, vector<Sopang::SourceSet> &curSegment)
 {
     curSegment.push_back(curVariant);
+    curSegment.back().compact();
+
     curVariant.reset();
 }
 
 void addReferenceSources(vector<Sopang::SourceSet> &segment, int sourceCount)
 {
+    // The reference variant consists of the sources which are not listed for any other variant.
     Sopang::SourceSet referenceVariant(sourceCount);
 
-    for (int sourceIdx = 0; sourceIdx < sourceCount; ++sourceIdx)
+    for (const Sopang::SourceSet &variant : segment)
     {
-        bool exists = false;
-
-        for (const Sopang::SourceSet &variant : segment)
-        {
-            if (variant.test(sourceIdx))
-            {
-                exists = true;
-                break;
-            }
-        }
-
-        if (not exists)
-        {
-            referenceVariant.set(sourceIdx);
-        }
+        referenceVariant |= variant;
     }
 
+    // It is usually dense, hence compacting it typically stores only the (small) union of the other variants.
+    referenceVariant.flip();
+    referenceVariant.compact();
+
     segment.emplace_back(move(referenceVariant));
 }
 
@@ -346,20 +451,33 @@ vector<vector<Sopang::SourceSet>> parseSources(string text, int &sourceCount)
 namespace // Contains helpers for parsing compressed sources.
 {
 
-int unpackNumber(const unsigned char first, const unsigned char second, size_t &shift)
+// Numbers are stored as base-128 varints with the most significant digit first: all digits except for the last one
+// are stored as they are (< 128), the last one is stored + 128. Hence numbers below 16,256 have the same encoding as in
+// the original two-byte format. A leading zero digit is skipped, it is written before numbers starting with digit 127
+// in order to distinguish them from the segment start mark.
+int unpackNumber(const string &text, size_t &charIdx)
 {
-    const int firstVal = static_cast<int>(first);
+    int ret = 0;
 
-    if (firstVal >= 128)
+    while (charIdx < text.size())
     {
-        shift = 1;
-        return firstVal - 128;
-    }
+        const int digit = static_cast<unsigned char>(text[charIdx]);
+        charIdx += 1;
 
-    const int secondVal = static_cast<int>(second);
+        if (ret > (numeric_limits<int>::max() >> 7))
+        {
+            throw runtime_error("compressed number out of range, index = " + to_string(charIdx));
+        }
+
+        if (digit >= 128)
+        {
+            return (ret << 7) | (digit - 128);
+        }
+
+        ret = (ret << 7) | digit;
+    }
 
-    shift = 2;
-    return firstVal * 128 + secondVal - 128;
+    throw runtime_error("compressed number is not terminated, index = " + to_string(charIdx));
 }
 
 } // namespace (anonymous)
@@ -374,7 +492,7 @@ vector<vector<Sopang::SourceSet>> parseSourcesCompressed(string text, int &sourc
 
     boost::trim(text);
 
-    size_t charIdx, shift;
+    size_t charIdx;
     sourceCount = parseSourceCount(text, charIdx);
 
     vector<vector<Sopang::SourceSet>> ret;
@@ -402,27 +520,27 @@ vector<vector<Sopang::SourceSet>> parseSourcesCompressed(string text, int &sourc
             continue;
         }
 
-        assert(charIdx < text.size());
-
-        // Note that even if (charIdx + 1) spills, it should be contained by the terminating '\0'.
-        const int variantSize = unpackNumber(text[charIdx], text[charIdx + 1], shift);
-        charIdx += shift;
-
+        const int variantSize = unpackNumber(text, charIdx);
         int prevVal = 0;
 
         for (int variantIdx = 0; variantIdx < variantSize; ++variantIdx)
         {
-            int sourceVal = unpackNumber(text[charIdx], text[charIdx + 1], shift);
-            sourceVal += prevVal;
+            // Source indexes are sorted, hence each one (except for the first) is stored as a positive difference.
+            const int diff = unpackNumber(text, charIdx);
 
-            assert(sourceVal <= sourceCount and (not curVariant.test(sourceVal)));
-            curVariant.set(sourceVal);
+            if (diff >= sourceCount - prevVal or (variantIdx > 0 and diff == 0))
+            {
+                throw runtime_error((boost::format("bad compressed source index difference = %1% after %2% (source count = %3%), index = %4%")
+                    % diff % prevVal % sourceCount % charIdx).str());
+            }
 
-            prevVal = sourceVal;
-            charIdx += shift;
+            prevVal += diff;
+            curVariant.set(prevVal);
         }
 
         curSegment.push_back(curVariant);
+        curSegment.back().compact();
+
         curVariant.reset();
     }
 
@@ -435,21 +553,9 @@ vector<vector<Sopang::SourceSet>> parseSourcesCompressed(string text, int &sourc
 }
 
 Sopang::SourceMap sourcesToSourceMap(int nSegments, const int *segmentSizes,
-    const vector<vector<Sopang::SourceSet>> &sources)
+    vector<vector<Sopang::SourceSet>> sources)
 {
-    unordered_map<int, vector<Sopang::SourceSet>> ret;
-    size_t arrayIdx = 0;
-
-    for (int iS = 0; iS < nSegments; ++iS)
-    {
-        if (segmentSizes[iS] > 1)
-        {
-            ret[iS] = sources[arrayIdx];
-            arrayIdx += 1;
-        }
-    }
-
-    return ret;
+    return Sopang::SourceMap(nSegments, segmentSizes, move(sources));
 }
 
 } // namespace sopang::parsing
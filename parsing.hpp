@@ -1,6 +1,8 @@
 #ifndef PARSING_HPP
 #define PARSING_HPP
 
+#include "alphabet.hpp"
+#include "ed_text.hpp"
 #include "sopang.hpp"
 
 #include <unordered_map>
@@ -11,13 +13,22 @@ namespace sopang::parsing
 {
 
 const std::string *const *parseTextArray(std::string text, int *nSegments, int **segmentSizes);
+/** Parses [text] directly into the flat layout, the segmentation is the same as for parseTextArray.
+ * Symbols are validated once here, throws if [text] contains a symbol outside [Alphabet]. */
+template<typename Alphabet = DnaAlphabet>
+EdText parseEdText(std::string text);
+/** Throws if any of [patterns] contains a symbol outside [Alphabet]. */
+template<typename Alphabet = DnaAlphabet>
+void validatePatterns(const std::vector<std::string> &patterns);
+
 std::vector<std::string> parsePatterns(std::string patternsStr);
 
 std::vector<std::vector<Sopang::SourceSet>> parseSources(std::string text, int &sourceCount);
 std::vector<std::vector<Sopang::SourceSet>> parseSourcesCompressed(std::string text, int &sourceCount);
 
+/** Moves [sources] into a flat source map, hence callers can pass a temporary in order to avoid copying the source sets. */
 Sopang::SourceMap sourcesToSourceMap(int nSegments, const int *segmentSizes,
-    const std::vector<std::vector<Sopang::SourceSet>> &sources);
+    std::vector<std::vector<Sopang::SourceSet>> sources);
 
 } // namespace sopang::parsing
 
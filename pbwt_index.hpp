@@ -0,0 +1,274 @@
+#ifndef PBWT_INDEX_HPP
+#define PBWT_INDEX_HPP
+
+#include "ed_text.hpp"
+#include "source_map.hpp"
+#include "source_set.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace sopang
+{
+
+/** Positional Burrows-Wheeler transform (PBWT) over the variants taken by sources in non-deterministic segments.
+ * The i-th non-deterministic segment is column i. Orderings of sources are built from the last column backwards: ordering N (for N columns)
+ * is the identity and ordering i is ordering i + 1 stably sorted by the variants of column i. Hence sources taking the same variants
+ * in columns i..j are contiguous in ordering i and a path is matched right to left, narrowing an interval one column at a time.
+ * Variants of each column are stored in the order of the next ordering as runs in a flat (CSR-style) layout, together with
+ * per-variant counts sampled every rankSampleRate runs. Orderings are sampled every orderSampleRate columns. */
+class PbwtIndex
+{
+public:
+    /** Sources [begin, end) of ordering [level]. */
+    struct Interval
+    {
+        int level;
+        int begin;
+        int end;
+
+        bool empty() const { return begin >= end; }
+    };
+
+    PbwtIndex() = default;
+    /** Builds the index for [edText] with [sourceMap] having [sourceCount] sources, each source has to occur in exactly one variant
+     * of each non-deterministic segment (see SourceMap::calcSourceVariants). */
+    PbwtIndex(const EdText &edText, const SourceMap &sourceMap, int sourceCount);
+
+    bool empty() const { return segmentColumns.empty(); }
+    int sourceCount() const { return nSources; }
+
+    int nColumns() const { return static_cast<int>(columnRunOffsets.size()) - 1; }
+    size_t nRuns() const { return runStarts.size(); }
+
+    /** Column of segment [segmentIdx], -1 for deterministic segments. */
+    int column(int segmentIdx) const { return segmentColumns[segmentIdx]; }
+
+    /** All sources, an interval which does not restrict any column. */
+    Interval fullInterval() const { return Interval{ nColumns(), 0, nSources }; }
+
+    /** Narrows [interval] of sources which take the same variants in columns following [column] to the ones taking [variantIdx] in [column]. */
+    Interval extend(const Interval &interval, int column, int variantIdx) const;
+
+    /** Sets sources of [interval] in [sources]. */
+    void addSources(const Interval &interval, SourceSet &sources) const;
+
+    size_t sizeInBytes() const;
+
+    /** Number of runs between per-variant count samples, rank scans at most this many runs. */
+    static constexpr int rankSampleRate = 16;
+    /** Number of columns between sampled orderings, a source is located after at most this many steps. */
+    static constexpr int orderSampleRate = 64;
+
+private:
+    /** Column data is stored from the last column, as it is built backwards. */
+    int slot(int column) const { return nColumns() - 1 - column; }
+
+    /** Number of sources taking [variantIdx] in the first [pos] positions of [column]. */
+    int rank(int column, int variantIdx, int pos) const;
+    /** Index of the run of [column] containing [pos]. */
+    int findRun(int column, int pos) const;
+
+    /** Source at [pos] of ordering [level]. */
+    int locate(int level, int pos) const;
+
+    int nSources = 0;
+
+    std::vector<int> segmentColumns;
+
+    /** First position and variant of each run. */
+    std::vector<int> runStarts;
+    std::vector<int> runVariants;
+    std::vector<size_t> columnRunOffsets{ 0 };
+
+    /** For each variant of a column, the number of sources taking a smaller variant (the variant start in the preceding ordering). */
+    std::vector<int> variantStarts;
+    std::vector<size_t> columnVariantOffsets{ 0 };
+
+    /** Counts of each variant of a column before every rankSampleRate-th run of the column. */
+    std::vector<int> rankSamples;
+    std::vector<size_t> columnSampleOffsets{ 0 };
+
+    /** Orderings with levels divisible by orderSampleRate, nSources sources each. */
+    std::vector<int> orderSamples;
+};
+
+inline PbwtIndex::PbwtIndex(const EdText &edText, const SourceMap &sourceMap, int sourceCount)
+    :nSources(sourceCount),
+     segmentColumns(edText.nSegments(), -1)
+{
+    std::vector<int> columnSegments;
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        if (sourceMap.hasSources(iS))
+        {
+            segmentColumns[iS] = static_cast<int>(columnSegments.size());
+            columnSegments.push_back(iS);
+        }
+    }
+
+    const int nCols = static_cast<int>(columnSegments.size());
+
+    std::vector<int> order(sourceCount), nextOrder(sourceCount);
+    std::iota(order.begin(), order.end(), 0);
+
+    std::vector<int> sourceVariants, counts;
+    orderSamples.reserve((nCols / orderSampleRate + 1) * static_cast<size_t>(sourceCount));
+
+    for (int col = nCols; col >= 0; --col)
+    {
+        if (col % orderSampleRate == 0)
+        {
+            // Samples are stored in the build order, i.e. from the highest level.
+            orderSamples.insert(orderSamples.end(), order.begin(), order.end());
+        }
+
+        if (col == 0)
+            break;
+
+        const int segmentIdx = columnSegments[col - 1];
+        const int nVariants = sourceMap.segmentSize(segmentIdx);
+
+        sourceMap.calcSourceVariants(segmentIdx, sourceCount, sourceVariants);
+        counts.assign(nVariants, 0);
+
+        const size_t firstRun = runStarts.size();
+
+        for (int pos = 0; pos < sourceCount; ++pos)
+        {
+            const int variantIdx = sourceVariants[order[pos]];
+
+            if (pos == 0 or variantIdx != runVariants.back())
+            {
+                if ((runStarts.size() - firstRun) % rankSampleRate == 0)
+                {
+                    rankSamples.insert(rankSamples.end(), counts.begin(), counts.end());
+                }
+
+                runStarts.push_back(pos);
+                runVariants.push_back(variantIdx);
+            }
+
+            counts[variantIdx] += 1;
+        }
+
+        columnRunOffsets.push_back(runStarts.size());
+        columnSampleOffsets.push_back(rankSamples.size());
+
+        // Stable counting sort of the current ordering by variants of the column.
+        int start = 0;
+
+        for (int iV = 0; iV < nVariants; ++iV)
+        {
+            variantStarts.push_back(start);
+            start += counts[iV];
+        }
+
+        columnVariantOffsets.push_back(variantStarts.size());
+
+        std::vector<int> positions(variantStarts.end() - nVariants, variantStarts.end());
+
+        for (int pos = 0; pos < sourceCount; ++pos)
+        {
+            nextOrder[positions[sourceVariants[order[pos]]]++] = order[pos];
+        }
+
+        std::swap(order, nextOrder);
+    }
+}
+
+inline PbwtIndex::Interval PbwtIndex::extend(const Interval &interval, int column, int variantIdx) const
+{
+    // The full interval is the same for all orderings.
+    assert(interval.level == column + 1 or (interval.begin == 0 and interval.end == nSources));
+    assert(column >= 0 and column < nColumns());
+
+    const int variantStart = variantStarts[columnVariantOffsets[slot(column)] + variantIdx];
+
+    return Interval{ column,
+        variantStart + rank(column, variantIdx, interval.begin),
+        variantStart + rank(column, variantIdx, interval.end) };
+}
+
+inline void PbwtIndex::addSources(const Interval &interval, SourceSet &sources) const
+{
+    if (interval.begin == 0 and interval.end == nSources)
+    {
+        sources.set();
+        return;
+    }
+
+    for (int pos = interval.begin; pos < interval.end; ++pos)
+    {
+        sources.set(locate(interval.level, pos));
+    }
+}
+
+inline size_t PbwtIndex::sizeInBytes() const
+{
+    return (segmentColumns.size() + runStarts.size() + runVariants.size() + variantStarts.size() + rankSamples.size() + orderSamples.size()) * sizeof(int)
+        + (columnRunOffsets.size() + columnVariantOffsets.size() + columnSampleOffsets.size()) * sizeof(size_t);
+}
+
+inline int PbwtIndex::rank(int column, int variantIdx, int pos) const
+{
+    if (pos == 0)
+        return 0;
+
+    const int runIdx = findRun(column, pos - 1);
+    const size_t firstRun = columnRunOffsets[slot(column)];
+
+    const size_t nVariants = columnVariantOffsets[slot(column) + 1] - columnVariantOffsets[slot(column)];
+    const size_t sampleIdx = (runIdx - firstRun) / rankSampleRate;
+
+    int res = rankSamples[columnSampleOffsets[slot(column)] + sampleIdx * nVariants + variantIdx];
+
+    for (size_t iR = firstRun + sampleIdx * rankSampleRate; iR < static_cast<size_t>(runIdx); ++iR)
+    {
+        if (runVariants[iR] == variantIdx)
+        {
+            res += runStarts[iR + 1] - runStarts[iR];
+        }
+    }
+
+    if (runVariants[runIdx] == variantIdx)
+    {
+        res += pos - runStarts[runIdx];
+    }
+
+    return res;
+}
+
+inline int PbwtIndex::findRun(int column, int pos) const
+{
+    const auto begin = runStarts.begin() + columnRunOffsets[slot(column)];
+    const auto end = runStarts.begin() + columnRunOffsets[slot(column) + 1];
+
+    assert(begin != end and *begin == 0);
+    return static_cast<int>(std::upper_bound(begin, end, pos) - runStarts.begin()) - 1;
+}
+
+inline int PbwtIndex::locate(int level, int pos) const
+{
+    // Ordering level - 1 is ordering level sorted by variants of column level - 1, which are stored in the order of ordering level.
+    while (level % orderSampleRate != 0)
+    {
+        const int column = level - 1;
+        const int variantIdx = runVariants[findRun(column, pos)];
+
+        pos = variantStarts[columnVariantOffsets[slot(column)] + variantIdx] + rank(column, variantIdx, pos);
+        level = column;
+    }
+
+    const size_t sampleIdx = (nColumns() / orderSampleRate) - (level / orderSampleRate);
+    return orderSamples[sampleIdx * nSources + pos];
+}
+
+} // namespace sopang
+
+#endif // PBWT_INDEX_HPP
@@ -0,0 +1,159 @@
+#ifndef RESULT_SINK_HPP
+#define RESULT_SINK_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace sopang
+{
+
+/*
+ *** RESULT SINKS
+ */
+
+// Sinks receive indexes of segments in which pattern occurrences end. Indexes are delivered in increasing order
+// and each index is delivered at most once, hence the sinks do not have to sort or deduplicate them.
+// The search stops as soon as full() returns true after delivering an index.
+
+/** Collects indexes in a vector, which is sorted as a consequence of the delivery order. */
+struct SortedVectorSink
+{
+    void operator()(int segmentIdx) { indexes.push_back(segmentIdx); }
+    bool full() const { return false; }
+
+    std::vector<int> indexes;
+};
+
+/** Counts indexes without storing them. */
+struct CountSink
+{
+    void operator()(int) { count += 1; }
+    bool full() const { return false; }
+
+    int count = 0;
+};
+
+/** Only records whether any index was delivered, the search stops after the first one. */
+struct ExistsSink
+{
+    void operator()(int) { exists = true; }
+    bool full() const { return exists; }
+
+    bool exists = false;
+};
+
+/** Collects the first (i.e. smallest) [n] indexes, the search stops after the n-th one. */
+class FirstNSink
+{
+public:
+    explicit FirstNSink(int n);
+
+    void operator()(int segmentIdx);
+    bool full() const { return static_cast<int>(indexes.size()) == n; }
+
+    std::vector<int> indexes;
+
+private:
+    int n;
+};
+
+/** Marks indexes in a bitmap with a single bit per text segment. */
+class BitmapSink
+{
+public:
+    explicit BitmapSink(int nSegments);
+
+    void operator()(int segmentIdx);
+    bool full() const { return false; }
+
+    bool test(int segmentIdx) const;
+    int count() const;
+
+    std::vector<int> toVector() const;
+
+private:
+    std::vector<uint64_t> words;
+};
+
+/** Passes each index to a user function. */
+class CallbackSink
+{
+public:
+    CallbackSink(std::function<void(int)> callback);
+
+    void operator()(int segmentIdx) { callback(segmentIdx); }
+    bool full() const { return false; }
+
+private:
+    std::function<void(int)> callback;
+};
+
+inline FirstNSink::FirstNSink(int n)
+    :n(n)
+{
+    assert(n > 0);
+    indexes.reserve(n);
+}
+
+inline void FirstNSink::operator()(int segmentIdx)
+{
+    assert(not full());
+    indexes.push_back(segmentIdx);
+}
+
+inline BitmapSink::BitmapSink(int nSegments)
+    :words((nSegments + 63) / 64, 0x0ULL)
+{ }
+
+inline void BitmapSink::operator()(int segmentIdx)
+{
+    assert(segmentIdx >= 0 and static_cast<size_t>(segmentIdx) < words.size() * 64);
+    words[segmentIdx / 64] |= (0x1ULL << (segmentIdx % 64));
+}
+
+inline bool BitmapSink::test(int segmentIdx) const
+{
+    assert(segmentIdx >= 0 and static_cast<size_t>(segmentIdx) < words.size() * 64);
+    return (words[segmentIdx / 64] & (0x1ULL << (segmentIdx % 64))) != 0x0ULL;
+}
+
+inline int BitmapSink::count() const
+{
+    int res = 0;
+
+    for (const uint64_t word : words)
+    {
+        res += __builtin_popcountll(word);
+    }
+
+    return res;
+}
+
+inline std::vector<int> BitmapSink::toVector() const
+{
+    std::vector<int> res;
+
+    for (size_t iW = 0; iW < words.size(); ++iW)
+    {
+        uint64_t word = words[iW];
+
+        while (word != 0x0ULL)
+        {
+            res.push_back(static_cast<int>(iW * 64) + __builtin_ctzll(word));
+            word &= (word - 1);
+        }
+    }
+
+    return res;
+}
+
+inline CallbackSink::CallbackSink(std::function<void(int)> callback)
+    :callback(std::move(callback))
+{ }
+
+} // namespace sopang
+
+#endif // RESULT_SINK_HPP
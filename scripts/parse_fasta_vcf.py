@@ -114,11 +114,21 @@ def getSourcesMapFromVcfReader(vcfReader, lineCount):
 
 
 def packNumber(x):
-    assert isinstance(x, int)
-    if x < 128:
-        return [128 + x]
-    else:
-        return [int(x / 128), 128 + (x % 128)]
+    assert isinstance(x, int) and x >= 0
+
+    # Base-128 varint, the most significant digit comes first and the last digit is stored + 128.
+    ret = [128 + (x % 128)]
+    x //= 128
+
+    while x > 0:
+        ret = [x % 128] + ret
+        x //= 128
+
+    # A leading zero digit distinguishes a number starting with 127 from the segment start mark.
+    if ret[0] == 127:
+        ret = [0] + ret
+
+    return ret
 
 
 def processLineCompressed(line, charIdx, sourcesMap):
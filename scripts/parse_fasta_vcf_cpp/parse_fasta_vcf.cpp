@@ -334,16 +334,24 @@ pair<string, string> processLine(int &vcfPositionCount, int charIdx, const strin
 
 string packNumber(const int n)
 {
-    assert(n >= 0 and n <= 16'383);
+    assert(n >= 0);
 
-    if (n < 128)
+    // Base-128 varint, the most significant digit comes first and the last digit is stored + 128.
+    // Numbers below 16,256 are encoded in the same way as in the original two-byte format.
+    string ret(1, static_cast<char>(128 + (n % 128)));
+
+    for (int rest = n / 128; rest > 0; rest /= 128)
     {
-        return {static_cast<char>(128 + n)};
+        ret.insert(ret.begin(), static_cast<char>(rest % 128));
     }
-    else
+
+    // A leading zero digit is ignored by the parser, it distinguishes a number starting with 127 from the segment start mark.
+    if (ret[0] == 127)
     {
-        return {static_cast<char>(n / 128), static_cast<char>(128 + (n % 128))};
+        ret.insert(ret.begin(), static_cast<char>(0));
     }
+
+    return ret;
 }
 
 void dumpFiles(const string &textChars, const string &sourceChars, const string &outTextFilePath, const string &outSourcesFilePath)
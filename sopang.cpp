@@ -1,573 +1,2472 @@
 #include "sopang.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 using namespace std;
 
 namespace sopang
 {
 
-Sopang::Sopang(const std::string &alphabet)
-    :alphabet(alphabet)
+namespace
+{
+
+/** Collects indexes of a single chunk in matchParallel, the chunk scan stops once [stop] is set. */
+struct ChunkSink
+{
+    void operator()(int segmentIdx) { indexes.push_back(segmentIdx); }
+    bool full() const { return *stop; }
+
+    std::vector<int> indexes;
+    const std::atomic<bool> *stop = nullptr;
+};
+
+// Results of matching with sources are collected in the same way for all engines, which call the collectors with (segment index, sources,
+// whether the match is contained within a single deterministic segment). A match within a deterministic segment occurs in all sources.
+
+/** Sources of each segment containing matches, a match within a deterministic segment is denoted by an empty set. */
+struct SegmentSourcesCollector
+{
+    explicit SegmentSourcesCollector(int sourceCount)
+        :sourceCount(sourceCount) { }
+
+    bool operator()(int segmentIdx, SourceSet &sources, bool deterministicSegmentMatch)
+    {
+        if (deterministicSegmentMatch)
+        {
+            res.emplace(segmentIdx, sourceCount);
+        }
+        else if (sources.any())
+        {
+            res.emplace(segmentIdx, std::move(sources));
+        }
+
+        return true;
+    }
+
+    std::unordered_map<int, SourceSet> res;
+    int sourceCount;
+};
+
+/** Number of sources in which any match occurs, the scan stops once all sources match. */
+struct SourceCounter
+{
+    explicit SourceCounter(int sourceCount)
+        :sources(sourceCount), sourceCount(sourceCount) { }
+
+    bool operator()(int, SourceSet &segmentSources, bool deterministicSegmentMatch)
+    {
+        sources |= segmentSources;
+        allSources = deterministicSegmentMatch or (sources.count() == sourceCount);
+
+        return not allSources;
+    }
+
+    int count() const { return allSources ? sourceCount : sources.count(); }
+
+    SourceSet sources;
+    int sourceCount;
+    bool allSources = false;
+};
+
+/** Passes segments containing matches which occur in any source to [sink], the scan stops once the sink is full. */
+template<typename Sink>
+struct SegmentSinkCollector
+{
+    bool operator()(int segmentIdx, SourceSet &sources, bool deterministicSegmentMatch)
+    {
+        if (deterministicSegmentMatch or sources.any())
+        {
+            sink(segmentIdx);
+        }
+
+        return not sink.full();
+    }
+
+    Sink &sink;
+};
+
+}
+
+template<typename Alphabet>
+void BasicSopang<Alphabet>::reserveScratch(int maxSegmentSize)
+{
+    assert(maxSegmentSize >= 0);
+
+    if (static_cast<size_t>(maxSegmentSize) > dBuffer.size())
+    {
+        dBuffer.resize(maxSegmentSize);
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::match(const EdText &edText,
+    const string &pattern)
+{
+    SortedVectorSink sink;
+    match(edText, pattern, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::match(const EdText &edText,
+    const string &pattern,
+    Sink &sink)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternSize);
+
+    if (pattern.size() > wordSize)
+    {
+        int lastIdx = -1;
+
+        scanMultiWordDispatch(edText, pattern, [&sink, &lastIdx](int iS, int, int) {
+            if (iS != lastIdx)
+            {
+                sink(iS);
+                lastIdx = iS;
+            }
+
+            return not sink.full();
+        });
+
+        return;
+    }
+
+    fillPatternMaskBuffer(pattern);
+    scanSegmentsDispatch(edText, pattern.size(), sink);
+}
+
+template<typename Alphabet>
+vector<unordered_set<int>> BasicSopang<Alphabet>::matchBatch(const EdText &edText,
+    const vector<string> &patterns)
+{
+    vector<SortedVectorSink> sinks(patterns.size());
+    matchBatch(edText, patterns, sinks);
+
+    vector<unordered_set<int>> res;
+    res.reserve(sinks.size());
+
+    for (const SortedVectorSink &sink : sinks)
+    {
+        res.emplace_back(sink.indexes.begin(), sink.indexes.end());
+    }
+
+    return res;
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchBatch(const EdText &edText,
+    const vector<string> &patterns,
+    vector<Sink> &sinks)
+{
+    assert(edText.nSegments() > 0 and patterns.size() > 0 and sinks.size() == patterns.size());
+
+    const BatchLayout layout = calcBatchLayout(patterns);
+    const size_t nWords = layout.nWords;
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+
+    // States of all words, as in match the join over segment variants preserves 0s (active states), word-wise.
+    vector<uint64_t> D(nWords, allOnes), curD(nWords), joinD(nWords), hits(nWords);
+    size_t nFullSinks = count_if(sinks.begin(), sinks.end(), [](const Sink &sink) { return sink.full(); });
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        fill(joinD.begin(), joinD.end(), allOnes);
+        fill(hits.begin(), hits.end(), 0x0ULL);
+
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            copy(D.begin(), D.end(), curD.begin());
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                const uint64_t *masks = layout.masks.data() + Alphabet::code(*c) * nWords;
+
+                for (size_t iW = 0; iW < nWords; ++iW)
+                {
+                    // The bit shifted in from the last character of the preceding slot has to be cleared.
+                    curD[iW] = ((curD[iW] << 1) & (~layout.startMasks[iW])) | masks[iW];
+                    // Hits are gathered for the whole segment and reported once per segment.
+                    hits[iW] |= (~curD[iW]);
+                }
+            }
+
+            for (size_t iW = 0; iW < nWords; ++iW)
+            {
+                joinD[iW] &= curD[iW];
+            }
+        }
+
+        swap(D, joinD);
+
+        for (size_t iW = 0; iW < nWords; ++iW)
+        {
+            uint64_t wordHits = (hits[iW] & layout.hitMasks[iW]);
+
+            while (wordHits != 0x0ULL)
+            {
+                const int bitIdx = __builtin_ctzll(wordHits);
+                Sink &sink = sinks[layout.hitPatterns[iW * wordSize + bitIdx]];
+
+                if (not sink.full())
+                {
+                    sink(iS);
+
+                    if (sink.full())
+                    {
+                        nFullSinks += 1;
+                    }
+                }
+
+                wordHits &= (wordHits - 1);
+            }
+        }
+
+        if (nFullSinks == sinks.size())
+            return;
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchParallel(const EdText &edText,
+    const string &pattern,
+    int nThreads)
+{
+    SortedVectorSink sink;
+    matchParallel(edText, pattern, nThreads, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchParallel(const EdText &edText,
+    const string &pattern,
+    int nThreads,
+    Sink &sink)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternSize);
+    assert(nThreads > 0);
+
+    if (nThreads == 1 or pattern.size() > wordSize)
+    {
+        match(edText, pattern, sink);
+        return;
+    }
+
+    fillPatternMaskBuffer(pattern);
+    const uint64_t hitMask = (0x1ULL << (pattern.size() - 1));
+
+    vector<bool> anchored;
+    const vector<int> bounds = calcChunkBounds(edText, pattern.size(), nThreads, anchored);
+    const size_t nChunks = bounds.size() - 1;
+
+    vector<ChunkSink> chunkHits(nChunks);
+    vector<uint64_t> chunkEndStates(nChunks);
+
+    // Set once the sink is full, the remaining chunks are then skipped or stopped, as their hits would not be delivered.
+    atomic<bool> sinkFull{ false };
+
+    for (ChunkSink &curHits : chunkHits)
+    {
+        curHits.stop = &sinkFull;
+    }
+
+    // Chunks are delivered to the sink in order as soon as all preceding chunks are scanned.
+    mutex deliveryMutex;
+    vector<bool> chunkScanned(nChunks, false);
+    size_t nDelivered = 0;
+
+    // Chunks which are not anchored were scanned from the initial state, so they might have missed matches
+    // spanning their start. We rescan them from the actual state until each path has consumed at least m - 1 characters,
+    // from that point on the state does not depend on the chunk start.
+    const int nMinConsumed = static_cast<int>(pattern.size()) - 1;
+    uint64_t D = allOnes;
+
+    const auto deliverChunk = [&](size_t iC) {
+        SortedVectorSink reconciledHits;
+
+        if (iC == 0 or anchored[iC])
+        {
+            D = chunkEndStates[iC];
+        }
+        else
+        {
+            int nConsumed = 0;
+
+            for (int iS = bounds[iC]; iS < bounds[iC + 1] and nConsumed < nMinConsumed; ++iS)
+            {
+                D = scanSegments(edText, iS, iS + 1, D, hitMask, reconciledHits);
+                int minVariantSize = edText.variantSize(iS, 0);
+
+                for (int iV = 1; iV < edText.segmentSize(iS); ++iV)
+                {
+                    minVariantSize = min(minVariantSize, edText.variantSize(iS, iV));
+                }
+
+                nConsumed += minVariantSize;
+            }
+
+            if (nConsumed >= nMinConsumed)
+            {
+                D = chunkEndStates[iC];
+            }
+        }
+
+        // Both chunk hits and reconciled hits are increasing and lie within the chunk, a single merge restores the order.
+        vector<int> hits(chunkHits[iC].indexes.size() + reconciledHits.indexes.size());
+
+        merge(chunkHits[iC].indexes.begin(), chunkHits[iC].indexes.end(), reconciledHits.indexes.begin(), reconciledHits.indexes.end(), hits.begin());
+
+        for (size_t i = 0; i < hits.size() and not sink.full(); ++i)
+        {
+            if (i == 0 or hits[i] != hits[i - 1])
+            {
+                sink(hits[i]);
+            }
+        }
+
+        if (sink.full())
+        {
+            sinkFull = true;
+        }
+    };
+
+    calcChunkPool(nThreads).run(static_cast<int>(nChunks), [&](int iC, int) {
+        if (not sinkFull)
+        {
+            uint64_t startD = allOnes;
+
+            if (iC > 0 and anchored[iC])
+            {
+                // Matches ending in the anchor segment are reported by the preceding chunk.
+                CountSink anchorHits;
+                startD = scanSegments(edText, bounds[iC] - 1, bounds[iC], allOnes, hitMask, anchorHits);
+            }
+
+            chunkEndStates[iC] = scanSegments(edText, bounds[iC], bounds[iC + 1], startD, hitMask, chunkHits[iC]);
+        }
+
+        lock_guard<mutex> lock(deliveryMutex);
+        chunkScanned[iC] = true;
+
+        for (; nDelivered < nChunks and chunkScanned[nDelivered] and not sinkFull; ++nDelivered)
+        {
+            deliverChunk(nDelivered);
+        }
+    });
+}
+
+template<typename Alphabet>
+ThreadPool &BasicSopang<Alphabet>::calcChunkPool(int nThreads)
+{
+    if (not chunkPool or chunkPool->size() != nThreads)
+    {
+        chunkPool = make_unique<ThreadPool>(nThreads);
+    }
+
+    return *chunkPool;
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchApprox(const EdText &edText,
+    const string &pattern,
+    int k)
+{
+    SortedVectorSink sink;
+    matchApprox(edText, pattern, k, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchApprox(const EdText &edText,
+    const string &pattern,
+    int k,
+    Sink &sink)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternApproxSize);
+    assert(k > 0 and k <= maxApproxErrors);
+
+    if (pattern.size() > maxPatternApproxSingleWordSize or static_cast<uint64_t>(k) >= saFullCounter)
+    {
+        if (pattern.size() <= saFullCounter and static_cast<uint64_t>(k) < saFullCounter)
+        {
+            matchApproxMultiWord<saCounterSize>(edText, pattern, k, sink);
+        }
+        else
+        {
+            matchApproxMultiWord<8>(edText, pattern, k, sink);
+        }
+
+        return;
+    }
+
+    fillPatternMaskBufferApprox(pattern);
+    reserveScratch(edText.maxSegmentSize());
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+
+    // This is the initial position of each counter, after k + 1 errors the most significant bit will be set.
+    const uint64_t counterMask = 0xFULL - k;
+    // Hit mask indicates whether the most significant bit in the last counter is set.
+    const uint64_t hitMask = (0x1ULL << ((pattern.size() * saCounterSize) - 1));
+
+    uint64_t D = 0x0ULL;
+
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        // We initialize the state with full counters which allow us to effectively start matching
+        // after m characters.
+        D |= (saFullCounter << (i * saCounterSize));
+    }
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        const int segmentSize = segmentOffsets[iS + 1] - segmentOffsets[iS];
+        assert(segmentSize > 0 and static_cast<size_t>(segmentSize) <= dBuffer.size());
+
+        // The most significant bit of the last counter is cleared if a match occurred anywhere in the segment.
+        uint64_t hitD = allOnes;
+
+        for (int iD = 0; iD < segmentSize; ++iD)
+        {
+            const int iV = segmentOffsets[iS] + iD;
+            uint64_t curD = D;
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                curD <<= saCounterSize;
+                curD += counterMask;
+
+                curD += maskBuffer[Alphabet::code(*c)];
+
+                hitD &= curD;
+            }
+
+            dBuffer[iD] = curD;
+        }
+
+        if ((hitD & hitMask) == 0x0ULL)
+        {
+            sink(iS);
+
+            if (sink.full())
+                return;
+        }
+
+        // As a join operation, we take the minimum (the most promising alternative) from each counter.
+        D = dBuffer[0];
+
+        for (int iD = 1; iD < segmentSize; ++iD)
+        {
+            D = minCounters<saCounterSize>(D, dBuffer[iD]);
+        }
+    }
+}
+
+template<typename Alphabet>
+template<size_t B, typename Sink>
+void BasicSopang<Alphabet>::matchApproxMultiWord(const EdText &edText,
+    const string &pattern,
+    int k,
+    Sink &sink)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    const size_t nWords = (pattern.size() + countersPerWord - 1) / countersPerWord;
+
+    fillPatternMaskBufferApproxMultiWord<B>(pattern, nWords);
+    scanApproxMultiWord<B>(edText, 0, edText.nSegments(), pattern.size(), k, sink);
+}
+
+template<typename Alphabet>
+template<size_t B, typename Sink>
+void BasicSopang<Alphabet>::scanApproxMultiWord(const EdText &edText,
+    int beginIdx,
+    int endIdx,
+    size_t patternSize,
+    int k,
+    Sink &sink) const
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    constexpr uint64_t fullCounter = (0x1ULL << (B - 1));
+
+    // A counter starts at most at fullCounter and gets at most m - 1 increments before it is shifted out.
+    assert(patternSize > 0 and patternSize <= fullCounter);
+    assert(k > 0 and static_cast<uint64_t>(k) < fullCounter);
+    assert(beginIdx >= 0 and beginIdx <= endIdx and endIdx <= edText.nSegments());
+
+    const size_t nWords = (patternSize + countersPerWord - 1) / countersPerWord;
+    assert(nWords <= maxApproxWords);
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const size_t lastWordIdx = nWords - 1;
+
+    // This is the initial position of each counter, after k + 1 errors the most significant bit will be set.
+    const uint64_t counterStart = fullCounter - 1 - k;
+    // Hit mask indicates whether the most significant bit in the counter for the last pattern character is set.
+    const uint64_t hitMask = (fullCounter << (((patternSize - 1) % countersPerWord) * B));
+
+    uint64_t D[maxApproxWords], curD[maxApproxWords], joinD[maxApproxWords];
+    initApproxMultiWord<B>(D, nWords);
+
+    for (int iS = beginIdx; iS < endIdx; ++iS)
+    {
+        // The most significant bit of the last counter is cleared if a match occurred anywhere in the segment.
+        uint64_t hitD = allOnes;
+
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            copy(D, D + nWords, curD);
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                shiftAddMultiWord<B>(curD, approxMaskBuffer + Alphabet::code(*c) * maxApproxWords, nWords, counterStart);
+                hitD &= curD[lastWordIdx];
+            }
+
+            // As a join operation, we take the minimum (the most promising alternative) from each counter.
+            if (iV == segmentOffsets[iS])
+            {
+                copy(curD, curD + nWords, joinD);
+            }
+            else
+            {
+                for (size_t iW = 0; iW < nWords; ++iW)
+                {
+                    joinD[iW] = minCounters<B>(joinD[iW], curD[iW]);
+                }
+            }
+        }
+
+        if ((hitD & hitMask) == 0x0ULL)
+        {
+            sink(iS);
+
+            if (sink.full())
+                return;
+        }
+
+        copy(joinD, joinD + nWords, D);
+    }
+}
+
+template<typename Alphabet>
+unordered_map<int, int> BasicSopang<Alphabet>::matchApproxMinDistance(const EdText &edText,
+    const string &pattern,
+    int kMax)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternApproxSize);
+    assert(kMax > 0 and kMax <= maxApproxErrors);
+
+    unordered_map<int, int> res;
+
+    if (pattern.size() <= saFullCounter and static_cast<uint64_t>(kMax) < saFullCounter)
+    {
+        matchApproxMinDistanceMultiWord<saCounterSize>(edText, pattern, kMax, res);
+    }
+    else
+    {
+        matchApproxMinDistanceMultiWord<8>(edText, pattern, kMax, res);
+    }
+
+    return res;
+}
+
+template<typename Alphabet>
+template<size_t B>
+void BasicSopang<Alphabet>::matchApproxMinDistanceMultiWord(const EdText &edText,
+    const string &pattern,
+    int kMax,
+    unordered_map<int, int> &res)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    constexpr uint64_t fullCounter = (0x1ULL << (B - 1));
+    constexpr uint64_t counterAllSet = (0x1ULL << B) - 1;
+
+    assert(pattern.size() > 0 and pattern.size() <= fullCounter);
+    assert(kMax > 0 and static_cast<uint64_t>(kMax) < fullCounter);
+
+    const size_t nWords = (pattern.size() + countersPerWord - 1) / countersPerWord;
+    assert(nWords <= maxApproxWords);
+
+    fillPatternMaskBufferApproxMultiWord<B>(pattern, nWords);
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+    const size_t lastWordIdx = nWords - 1;
+
+    // Each counter starts at counterStart and is incremented once per mismatch, hence the counter for the last pattern character
+    // holds counterStart + the number of mismatches, a set most significant bit indicates more than kMax mismatches.
+    const uint64_t counterStart = fullCounter - 1 - kMax;
+    const size_t lastCounterShift = ((pattern.size() - 1) % countersPerWord) * B;
+
+    uint64_t D[maxApproxWords], curD[maxApproxWords], joinD[maxApproxWords];
+    initApproxMultiWord<B>(D, nWords);
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        // Counter-wise minimum of the last word over all characters of the segment.
+        uint64_t minD = allOnes;
+
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            copy(D, D + nWords, curD);
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                shiftAddMultiWord<B>(curD, approxMaskBuffer + Alphabet::code(*c) * maxApproxWords, nWords, counterStart);
+                minD = minCounters<B>(minD, curD[lastWordIdx]);
+            }
+
+            if (iV == segmentOffsets[iS])
+            {
+                copy(curD, curD + nWords, joinD);
+            }
+            else
+            {
+                for (size_t iW = 0; iW < nWords; ++iW)
+                {
+                    joinD[iW] = minCounters<B>(joinD[iW], curD[iW]);
+                }
+            }
+        }
+
+        const uint64_t lastCounter = (minD >> lastCounterShift) & counterAllSet;
+
+        if (lastCounter < fullCounter)
+        {
+            res[iS] = static_cast<int>(lastCounter - counterStart);
+        }
+
+        copy(joinD, joinD + nWords, D);
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchApproxFiltered(const EdText &edText,
+    const string &pattern,
+    int k)
+{
+    SortedVectorSink sink;
+    matchApproxFiltered(edText, pattern, k, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchApproxFiltered(const EdText &edText,
+    const string &pattern,
+    int k,
+    Sink &sink)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternApproxSize);
+    assert(k > 0 and k <= maxApproxErrors);
+
+    // Too short pieces occur almost everywhere, the filter would only add the cost of the exact scan.
+    if (pattern.size() / (k + 1) < minFilterPieceSize)
+    {
+        matchApprox(edText, pattern, k, sink);
+        return;
+    }
+
+    const vector<pair<int, int>> windows = calcFilterWindows(edText, pattern, k);
+
+    if (pattern.size() <= saFullCounter and static_cast<uint64_t>(k) < saFullCounter)
+    {
+        verifyFilterWindows<saCounterSize>(edText, pattern, k, windows, sink);
+    }
+    else
+    {
+        verifyFilterWindows<8>(edText, pattern, k, windows, sink);
+    }
+}
+
+template<typename Alphabet>
+vector<pair<int, int>> BasicSopang<Alphabet>::calcFilterWindows(const EdText &edText,
+    const string &pattern,
+    int k)
+{
+    const size_t nPieces = k + 1;
+    assert(pattern.size() >= nPieces);
+
+    // Pieces are as even as possible, the first (m mod (k + 1)) pieces are longer by one character.
+    vector<string> pieces;
+    vector<int> pieceEnds;
+
+    for (size_t iP = 0, pieceStart = 0; iP < nPieces; ++iP)
+    {
+        const size_t pieceSize = pattern.size() / nPieces + (iP < pattern.size() % nPieces ? 1 : 0);
+        assert(pieceSize <= wordSize);
+
+        pieces.push_back(pattern.substr(pieceStart, pieceSize));
+        pieceStart += pieceSize;
+        pieceEnds.push_back(static_cast<int>(pieceStart));
+    }
+
+    vector<SortedVectorSink> pieceMatches(nPieces);
+    matchBatch(edText, pieces, pieceMatches);
+
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+
+    // Each path through a segment contains at least as many characters as its shortest variant.
+    const auto minVariantSize = [variantOffsets, segmentOffsets](int iS) {
+        size_t res = variantOffsets[segmentOffsets[iS] + 1] - variantOffsets[segmentOffsets[iS]];
+
+        for (int iV = segmentOffsets[iS] + 1; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            res = min(res, variantOffsets[iV + 1] - variantOffsets[iV]);
+        }
+
+        return static_cast<int>(res);
+    };
+
+    vector<pair<int, int>> windows;
+
+    for (size_t iP = 0; iP < nPieces; ++iP)
+    {
+        // A piece ending in segment iS is preceded by pieceEnds[iP] - 1 and followed by m - pieceEnds[iP] pattern characters.
+        // The window is extended until the segments in between are guaranteed to hold more characters than that.
+        const int nBefore = pieceEnds[iP];
+        const int nAfter = static_cast<int>(pattern.size()) - pieceEnds[iP];
+
+        for (const int iS : pieceMatches[iP].indexes)
+        {
+            int beginIdx = iS, endIdx = iS;
+
+            for (int nChars = 0; beginIdx > 0 and nChars < nBefore; )
+            {
+                beginIdx -= 1;
+                nChars += minVariantSize(beginIdx);
+            }
+
+            for (int nChars = 0; endIdx < nSegments - 1 and nChars < nAfter; )
+            {
+                endIdx += 1;
+                nChars += minVariantSize(endIdx);
+            }
+
+            windows.emplace_back(beginIdx, endIdx + 1);
+        }
+    }
+
+    sort(windows.begin(), windows.end());
+
+    // Overlapping windows are merged, so that each segment is verified at most once and hits are delivered in order.
+    vector<pair<int, int>> res;
+
+    for (const pair<int, int> &window : windows)
+    {
+        if (not res.empty() and window.first < res.back().second)
+        {
+            res.back().second = max(res.back().second, window.second);
+        }
+        else
+        {
+            res.push_back(window);
+        }
+    }
+
+    return res;
+}
+
+template<typename Alphabet>
+template<size_t B, typename Sink>
+void BasicSopang<Alphabet>::verifyFilterWindows(const EdText &edText,
+    const string &pattern,
+    int k,
+    const vector<pair<int, int>> &windows,
+    Sink &sink)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    const size_t nWords = (pattern.size() + countersPerWord - 1) / countersPerWord;
+
+    fillPatternMaskBufferApproxMultiWord<B>(pattern, nWords);
+
+    for (const pair<int, int> &window : windows)
+    {
+        // Each window starts with a fresh state, an occurrence cannot begin before the window containing its exact piece.
+        scanApproxMultiWord<B>(edText, window.first, window.second, pattern.size(), k, sink);
+
+        if (sink.full())
+            return;
+    }
+}
+
+template<typename Alphabet>
+template<typename OnSegment>
+void BasicSopang<Alphabet>::scanCandidatesApprox(const EdText &edText,
+    const string &pattern,
+    int k,
+    OnSegment onSegment)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternApproxSize);
+    assert(k > 0 and k <= maxApproxErrors);
+
+    // Reachable sources depend on the pattern and k, breadcrumbs are recorded only by the exact scan.
+    clearSourcesMemo();
+    liveVariantsValid = false;
+
+    if (pattern.size() <= saFullCounter and static_cast<uint64_t>(k) < saFullCounter)
+    {
+        scanCandidatesApproxMultiWord<saCounterSize>(edText, pattern, k, onSegment);
+    }
+    else
+    {
+        scanCandidatesApproxMultiWord<8>(edText, pattern, k, onSegment);
+    }
+}
+
+template<typename Alphabet>
+template<size_t B, typename OnSegment>
+void BasicSopang<Alphabet>::scanCandidatesApproxMultiWord(const EdText &edText,
+    const string &pattern,
+    int k,
+    OnSegment onSegment)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    constexpr uint64_t fullCounter = (0x1ULL << (B - 1));
+
+    assert(pattern.size() > 0 and pattern.size() <= fullCounter);
+    assert(k > 0 and static_cast<uint64_t>(k) < fullCounter);
+
+    const size_t nWords = (pattern.size() + countersPerWord - 1) / countersPerWord;
+    assert(nWords <= maxApproxWords);
+
+    fillPatternMaskBufferApproxMultiWord<B>(pattern, nWords);
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+    const size_t lastWordIdx = nWords - 1;
+
+    const uint64_t counterStart = fullCounter - 1 - k;
+    const uint64_t hitMask = (fullCounter << (((pattern.size() - 1) % countersPerWord) * B));
+
+    // [(variant index, char in variant index)] for the current segment.
+    vector<pair<int, int>> segmentMatches;
+
+    uint64_t D[maxApproxWords], curD[maxApproxWords], joinD[maxApproxWords];
+    initApproxMultiWord<B>(D, nWords);
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            copy(D, D + nWords, curD);
+            const char *variant = chars + variantOffsets[iV];
+
+            for (const char *c = variant; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                shiftAddMultiWord<B>(curD, approxMaskBuffer + Alphabet::code(*c) * maxApproxWords, nWords, counterStart);
+
+                if ((curD[lastWordIdx] & hitMask) == 0x0ULL)
+                {
+                    segmentMatches.emplace_back(iV - segmentOffsets[iS], static_cast<int>(c - variant));
+                }
+            }
+
+            if (iV == segmentOffsets[iS])
+            {
+                copy(curD, curD + nWords, joinD);
+            }
+            else
+            {
+                for (size_t iW = 0; iW < nWords; ++iW)
+                {
+                    joinD[iW] = minCounters<B>(joinD[iW], curD[iW]);
+                }
+            }
+        }
+
+        if (not segmentMatches.empty())
+        {
+            if (not onSegment(iS, segmentMatches))
+                return;
+
+            segmentMatches.clear();
+        }
+
+        copy(joinD, joinD + nWords, D);
+    }
+}
+
+template<typename Alphabet>
+template<size_t B>
+void BasicSopang<Alphabet>::initApproxMultiWord(uint64_t *D, size_t nWords)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    constexpr uint64_t fullCounter = (0x1ULL << (B - 1));
+
+    for (size_t iW = 0; iW < nWords; ++iW)
+    {
+        D[iW] = 0x0ULL;
+
+        // Full counters allow us to effectively start matching after m characters.
+        for (size_t i = 0; i < countersPerWord; ++i)
+        {
+            D[iW] |= (fullCounter << (i * B));
+        }
+    }
+}
+
+template<typename Alphabet>
+template<size_t B>
+inline void BasicSopang<Alphabet>::shiftAddMultiWord(uint64_t *D, const uint64_t *masks, size_t nWords, uint64_t counterStart)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    // Bits above the last counter in a word are kept cleared, they are discarded after each shift.
+    constexpr uint64_t usedBits = (countersPerWord * B == wordSize) ? allOnes : ((0x1ULL << (countersPerWord * B)) - 1);
+    // The offset of the most significant counter in a word, it is carried to the next word on a shift.
+    constexpr size_t topCounterShift = (countersPerWord - 1) * B;
+    constexpr uint64_t counterAllSet = (0x1ULL << B) - 1;
+
+    // We go from the most significant word so that the carried counter is taken from the unshifted lower word.
+    for (size_t iW = nWords - 1; iW > 0; --iW)
+    {
+        const uint64_t carried = ((D[iW - 1] >> topCounterShift) & counterAllSet);
+        D[iW] = (((D[iW] << B) | carried) & usedBits) + masks[iW];
+    }
+
+    D[0] = ((D[0] << B) & usedBits) + counterStart + masks[0];
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchEdit(const EdText &edText,
+    const string &pattern,
+    int k)
+{
+    SortedVectorSink sink;
+    matchEdit(edText, pattern, k, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchEdit(const EdText &edText,
+    const string &pattern,
+    int k,
+    Sink &sink)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternEditSize);
+    assert(k > 0 and k <= maxEditErrors);
+
+    static_assert(maxPatternEditSize <= wordSize, "edit distance states must fit in a single word");
+    fillPatternMaskBuffer(pattern);
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+    const uint64_t hitMask = (0x1ULL << (pattern.size() - 1));
+
+    // D[d] has a 0 at bit j if the pattern prefix of length j + 1 ends at the current position with at most d errors.
+    uint64_t D[maxEditErrors + 1], curD[maxEditErrors + 1], joinD[maxEditErrors + 1];
+
+    for (int d = 0; d <= k; ++d)
+    {
+        // Prefixes of up to d characters can be deleted.
+        D[d] = (allOnes << d);
+    }
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        // The hit bit of the last state is cleared if a match occurred anywhere in the segment.
+        uint64_t hitD = allOnes;
+        fill(joinD, joinD + k + 1, allOnes);
+
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            // An empty variant passes the state through unchanged.
+            copy(D, D + k + 1, curD);
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                const uint64_t mask = maskBuffer[Alphabet::code(*c)];
+
+                // The state for d - 1 errors before processing the current character.
+                uint64_t prevD = curD[0];
+                curD[0] = (curD[0] << 1) | mask;
+
+                for (int d = 1; d <= k; ++d)
+                {
+                    const uint64_t oldD = curD[d];
+
+                    // Match, insertion (prevD), substitution (prevD << 1) and deletion (curD[d - 1] << 1).
+                    curD[d] = ((oldD << 1) | mask) & prevD & ((prevD & curD[d - 1]) << 1);
+                    prevD = oldD;
+                }
+
+                hitD &= curD[k];
+            }
+
+            // As a join operation we preserve active states separately for each number of errors.
+            for (int d = 0; d <= k; ++d)
+            {
+                joinD[d] &= curD[d];
+            }
+        }
+
+        if ((hitD & hitMask) == 0x0ULL)
+        {
+            sink(iS);
+
+            if (sink.full())
+                return;
+        }
+
+        copy(joinD, joinD + k + 1, D);
+    }
+}
+
+namespace
+{
+
+/** Compares [variant] (going backwards from its end) with [pattern] starting at [patternIdx], updates [patternIdx] and [nErrors].
+ * Stops when the variant or the pattern is exhausted or when [nErrors] exceeds [k]. */
+void verifyVariantApprox(const string &pattern,
+    int k,
+    const char *variant,
+    int variantSize,
+    int &patternIdx,
+    int &nErrors)
+{
+    for (int iC = variantSize - 1; iC >= 0 and patternIdx >= 0 and nErrors <= k; --iC, --patternIdx)
+    {
+        if (pattern[patternIdx] != variant[iC])
+        {
+            nErrors += 1;
+        }
+    }
+}
+
+} // namespace (anonymous)
+
+template<typename Alphabet>
+template<typename OnSegment>
+void BasicSopang<Alphabet>::scanMatchSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k,
+    bool anySources,
+    OnSegment onSegment)
+{
+    const auto onMatches = [&](int segmentIdx, const vector<pair<int, int>> &matches) {
+        SourceSet segmentSources(sourceCount);
+        bool deterministicSegmentMatch = false;
+
+        for (const auto &match : matches)
+        {
+            segmentSources |= calcMatchSources(edText, sourceMap, sourceCount, pattern, k, segmentIdx, match, deterministicSegmentMatch);
+
+            if (deterministicSegmentMatch or (anySources and segmentSources.any()))
+                break;
+        }
+
+        return onSegment(segmentIdx, segmentSources, deterministicSegmentMatch);
+    };
+
+    if (k == 0)
+    {
+        scanCandidates(edText, pattern, onMatches);
+    }
+    else
+    {
+        scanCandidatesApprox(edText, pattern, k, onMatches);
+    }
+}
+
+template<typename Alphabet>
+typename BasicSopang<Alphabet>::SourceSet BasicSopang<Alphabet>::calcMatchSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k,
+    int matchIdx,
+    const pair<int, int> &match,
+    bool &deterministicSegmentMatch)
+{
+    SourceSet res(sourceCount);
+
+    // Characters of the variant in which the match ends are the same for all paths.
+    int patternIdx = static_cast<int>(pattern.size()) - 1;
+    int nErrors = 0;
+
+    verifyVariantApprox(pattern, k, edText.variantBegin(matchIdx, match.first), match.second + 1, patternIdx, nErrors);
+
+    if (nErrors > k)
+        return res;
+
+    const bool hasSources = sourceMap.hasSources(matchIdx);
+
+    if (patternIdx < 0) // The match is fully contained within a single segment.
+    {
+        if (hasSources)
+        {
+            assert(match.first >= 0 and match.first < sourceMap.segmentSize(matchIdx));
+            return sourceMap.sources(matchIdx, match.first);
+        }
+
+        deterministicSegmentMatch = true;
+        return res;
+    }
+
+    if (matchIdx == 0)
+        return res;
+
+    if (sourcesMemoBytes > maxSourcesMemoBytes)
+    {
+        clearSourcesMemo();
+    }
+
+    const SourceSet &reachable = calcReachableSources(edText, sourceMap, sourceCount, pattern, k, matchIdx - 1, patternIdx * (k + 1) + nErrors);
+
+    if (hasSources)
+    {
+        assert(match.first >= 0 and match.first < sourceMap.segmentSize(matchIdx));
+        return sourceMap.sources(matchIdx, match.first) & reachable;
+    }
+
+    return reachable;
+}
+
+template<typename Alphabet>
+const typename BasicSopang<Alphabet>::SourceSet &BasicSopang<Alphabet>::calcReachableSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k,
+    int segmentIdx,
+    int key)
+{
+    const int nKeys = static_cast<int>(pattern.size()) * (k + 1);
+    const auto memoKey = [nKeys](int segmentIdx, int key) { return static_cast<uint64_t>(segmentIdx) * nKeys + key; };
+
+    // A variant after which no pattern prefix is active in the forward scan does not lie on any matching path.
+    const int *segmentOffsets = edText.segmentOffsetData();
+    const auto isLive = [&](int segmentIdx, int variantIdx) {
+        const int v = segmentOffsets[segmentIdx] + variantIdx;
+        return not liveVariantsValid or ((liveVariants[v / wordSize] >> (v % wordSize)) & 0x1ULL) != 0x0ULL;
+    };
+
+    const auto memoIt = sourcesMemo.find(memoKey(segmentIdx, key));
+
+    if (memoIt != sourcesMemo.end())
+        return memoIt->second;
+
+    for (SourcesFrontier &frontier : frontiers)
+    {
+        assert(frontier.keys.empty());
+
+        if (static_cast<int>(frontier.present.size()) < nKeys)
+        {
+            frontier.present.resize(nKeys, 0);
+        }
+    }
+
+    SourcesFrontier *cur = &frontiers[0];
+    SourcesFrontier *next = &frontiers[1];
+
+    cur->keys.push_back(key);
+    cur->present[key] = 1;
+
+    // States which are not memoized yet are discovered going backwards segment by segment, states reached
+    // from several paths (e.g. after variants of the same length) are discovered once.
+    pendingStates.clear();
+
+    for (int iS = segmentIdx; iS >= 0 and not cur->keys.empty(); --iS)
+    {
+        for (const int curKey : cur->keys)
+        {
+            cur->present[curKey] = 0;
+            pendingStates.emplace_back(iS, curKey);
+
+            if (iS == 0)
+                continue;
+
+            for (int variantIdx = 0; variantIdx < edText.segmentSize(iS); ++variantIdx)
+            {
+                if (not isLive(iS, variantIdx))
+                    continue;
+
+                int curPatternIdx = curKey / (k + 1);
+                int curErrors = curKey % (k + 1);
+
+                verifyVariantApprox(pattern, k, edText.variantBegin(iS, variantIdx), edText.variantSize(iS, variantIdx), curPatternIdx, curErrors);
+
+                if (curErrors > k or curPatternIdx < 0)
+                    continue;
+
+                const int newKey = curPatternIdx * (k + 1) + curErrors;
+
+                if (not next->present[newKey] and sourcesMemo.count(memoKey(iS - 1, newKey)) == 0)
+                {
+                    next->present[newKey] = 1;
+                    next->keys.push_back(newKey);
+                }
+            }
+        }
+
+        cur->keys.clear();
+        swap(cur, next);
+    }
+
+    // States are resolved in the reverse order, hence the states preceding each state are already memoized.
+    for (auto stateIt = pendingStates.rbegin(); stateIt != pendingStates.rend(); ++stateIt)
+    {
+        const int iS = stateIt->first;
+        const int curKey = stateIt->second;
+
+        const int segmentSize = edText.segmentSize(iS);
+        // Deterministic segments do not restrict sources.
+        const bool deterministic = (segmentSize == 1);
+
+        assert(deterministic or sourceMap.segmentSize(iS) == segmentSize);
+        SourceSet reachable(sourceCount);
+
+        for (int variantIdx = 0; variantIdx < segmentSize; ++variantIdx)
+        {
+            if (not isLive(iS, variantIdx))
+                continue;
+
+            int curPatternIdx = curKey / (k + 1);
+            int curErrors = curKey % (k + 1);
+
+            verifyVariantApprox(pattern, k, edText.variantBegin(iS, variantIdx), edText.variantSize(iS, variantIdx), curPatternIdx, curErrors);
+
+            if (curErrors > k)
+                continue;
+
+            if (curPatternIdx < 0)
+            {
+                if (deterministic)
+                {
+                    reachable.set();
+                }
+                else
+                {
+                    reachable |= sourceMap.sources(iS, variantIdx);
+                }
+            }
+            else if (iS > 0)
+            {
+                const SourceSet &prevReachable = sourcesMemo.at(memoKey(iS - 1, curPatternIdx * (k + 1) + curErrors));
+
+                if (deterministic)
+                {
+                    reachable |= prevReachable;
+                }
+                else
+                {
+                    reachable |= (sourceMap.sources(iS, variantIdx) & prevReachable);
+                }
+            }
+        }
+
+        sourcesMemoBytes += reachable.sizeInBytes();
+        sourcesMemo.emplace(memoKey(iS, curKey), move(reachable));
+    }
+
+    return sourcesMemo.at(memoKey(segmentIdx, key));
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchWithSourcesVerify(const EdText &edText,
+    const Sopang::SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SortedVectorSink sink;
+    matchWithSourcesVerify(edText, sourceMap, sourceCount, pattern, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchWithSourcesVerify(const EdText &edText,
+    const Sopang::SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    Sink &sink)
+{
+    // Candidates are verified as soon as each segment is scanned, so that the scan can stop once the sink is full.
+    scanMatchSources(edText, sourceMap, sourceCount, pattern, 0, true, SegmentSinkCollector<Sink>{ sink });
+}
+
+template<typename Alphabet>
+unordered_map<int, typename BasicSopang<Alphabet>::SourceSet> BasicSopang<Alphabet>::matchWithSources(const EdText &edText,
+    const Sopang::SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SegmentSourcesCollector collector(sourceCount);
+    scanMatchSources(edText, sourceMap, sourceCount, pattern, 0, false, ref(collector));
+
+    return move(collector.res);
+}
+
+template<typename Alphabet>
+int BasicSopang<Alphabet>::countMatchingSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SourceCounter counter(sourceCount);
+    scanMatchSources(edText, sourceMap, sourceCount, pattern, 0, false, ref(counter));
+
+    return counter.count();
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchWithSourcesVerifyForward(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SortedVectorSink sink;
+    matchWithSourcesVerifyForward(edText, sourceMap, sourceCount, pattern, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchWithSourcesVerifyForward(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    Sink &sink)
+{
+    scanWithSources(edText, sourceMap, sourceCount, pattern, SegmentSinkCollector<Sink>{ sink });
+}
+
+template<typename Alphabet>
+unordered_map<int, typename BasicSopang<Alphabet>::SourceSet> BasicSopang<Alphabet>::matchWithSourcesForward(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SegmentSourcesCollector collector(sourceCount);
+    scanWithSources(edText, sourceMap, sourceCount, pattern, ref(collector));
+
+    return move(collector.res);
+}
+
+template<typename Alphabet>
+int BasicSopang<Alphabet>::countMatchingSourcesForward(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern)
+{
+    SourceCounter counter(sourceCount);
+    scanWithSources(edText, sourceMap, sourceCount, pattern, ref(counter));
+
+    return counter.count();
+}
+
+template<typename Alphabet>
+template<typename OnSegment>
+void BasicSopang<Alphabet>::scanWithSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    OnSegment onSegment)
+{
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternSourcesForwardSize);
+    fillPatternMaskBuffer(pattern);
+
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int m = static_cast<int>(pattern.size());
+    const uint64_t hitMask = (0x1ULL << (m - 1));
+    // Bits of all pattern prefixes, the shift overflows to 0 for a full word which yields all ones as well.
+    const uint64_t prefixMask = (hitMask << 1) - 1;
+
+    // The prefix of length j + 1 which ends after t text characters (along the current path) started after t - j characters.
+    // Its sources are kept in slot (t - j) mod wordSize, hence the slots do not move when the state is shifted.
+    // A new prefix only overwrites the slot of a prefix which would be longer than wordSize >= m, i.e. inactive.
+    if (forwardSlots.size() < 3 * wordSize)
+    {
+        forwardSlots.resize(3 * wordSize, SourceSet(0));
+    }
+
+    SourceSet *cur = forwardSlots.data();
+    SourceSet *variantSlots = cur + wordSize;
+    SourceSet *join = variantSlots + wordSize;
+
+    const auto slotOf = [](uint64_t t, int j) { return static_cast<size_t>((t - j) % wordSize); };
+
+    // Slots of prefixes which have not crossed any non-deterministic segment yet hold all sources, their sets are not materialized.
+    uint64_t fullSlots = 0x0ULL;
+
+    uint64_t D = allOnes;
+    uint64_t t = 0;
+
+    SourceSet segmentSources(sourceCount);
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        const uint64_t segmentStart = t;
+        bool deterministicSegmentMatch = false;
+
+        if (edText.segmentSize(iS) == 1)
+        {
+            const int iV = segmentOffsets[iS];
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                D <<= 1;
+                D |= maskBuffer[Alphabet::code(*c)];
+                t += 1;
+
+                if ((D & 0x1ULL) == 0x0ULL)
+                {
+                    fullSlots |= (0x1ULL << slotOf(t, 0));
+                }
+
+                if ((D & hitMask) == 0x0ULL)
+                {
+                    const size_t slot = slotOf(t, m - 1);
+
+                    if ((fullSlots & (0x1ULL << slot)) == 0x0ULL)
+                    {
+                        segmentSources |= cur[slot];
+                    }
+                    else if (t - m >= segmentStart)
+                    {
+                        deterministicSegmentMatch = true;
+                    }
+                    else // The match spans several deterministic segments.
+                    {
+                        segmentSources.set();
+                    }
+                }
+            }
+        }
+        else
+        {
+            uint64_t maxVariantSize = 0;
+
+            for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+            {
+                maxVariantSize = max<uint64_t>(maxVariantSize, variantOffsets[iV + 1] - variantOffsets[iV]);
+            }
+
+            // Prefixes from all variants are aligned to the end of the longest variant in the join.
+            const uint64_t segmentEnd = segmentStart + maxVariantSize;
+
+            uint64_t joinD = allOnes;
+            uint64_t joinSlots = 0x0ULL;
+
+            for (int variantIdx = 0; variantIdx < edText.segmentSize(iS); ++variantIdx)
+            {
+                const SourceSet &variantSources = sourceMap.sources(iS, variantIdx);
+
+                if (not variantSources.any())
+                    continue;
+
+                uint64_t curD = D;
+
+                // Prefixes entering the variant are restricted to its sources, the ones with no sources left are inactive.
+                for (uint64_t active = ~D & prefixMask; active != 0x0ULL; active &= (active - 1))
+                {
+                    const int j = __builtin_ctzll(active);
+                    const size_t slot = slotOf(segmentStart, j);
+
+                    if ((fullSlots & (0x1ULL << slot)) != 0x0ULL)
+                    {
+                        variantSlots[slot] = variantSources;
+                    }
+                    else
+                    {
+                        variantSlots[slot] = (cur[slot] & variantSources);
+
+                        if (not variantSlots[slot].any())
+                        {
+                            curD |= (0x1ULL << j);
+                        }
+                    }
+                }
+
+                const int iV = segmentOffsets[iS] + variantIdx;
+                uint64_t curT = segmentStart;
+
+                for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+                {
+                    curD <<= 1;
+                    curD |= maskBuffer[Alphabet::code(*c)];
+                    curT += 1;
+
+                    if ((curD & 0x1ULL) == 0x0ULL)
+                    {
+                        variantSlots[slotOf(curT, 0)] = variantSources;
+                    }
+
+                    if ((curD & hitMask) == 0x0ULL)
+                    {
+                        segmentSources |= variantSlots[slotOf(curT, m - 1)];
+                    }
+                }
+
+                // As in Shift-Or, the join unites prefixes of the same length from all variants.
+                for (uint64_t active = ~curD & prefixMask; active != 0x0ULL; active &= (active - 1))
+                {
+                    const int j = __builtin_ctzll(active);
+                    const size_t joinSlot = slotOf(segmentEnd, j);
+
+                    if ((joinSlots & (0x1ULL << joinSlot)) != 0x0ULL)
+                    {
+                        join[joinSlot] |= variantSlots[slotOf(curT, j)];
+                    }
+                    else
+                    {
+                        join[joinSlot] = variantSlots[slotOf(curT, j)];
+                        joinSlots |= (0x1ULL << joinSlot);
+                    }
+                }
+
+                joinD &= curD;
+            }
+
+            D = joinD;
+            t = segmentEnd;
+
+            swap(cur, join);
+            fullSlots = 0x0ULL;
+        }
+
+        if (deterministicSegmentMatch or segmentSources.any())
+        {
+            if (not onSegment(iS, segmentSources, deterministicSegmentMatch))
+                return;
+
+            segmentSources = SourceSet(sourceCount);
+        }
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchWithSourcesVerifyHaplotype(const EdText &edText,
+    const HaplotypeIndex &haplotypeIndex,
+    const string &pattern)
+{
+    SortedVectorSink sink;
+    matchWithSourcesVerifyHaplotype(edText, haplotypeIndex, pattern, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchWithSourcesVerifyHaplotype(const EdText &edText,
+    const HaplotypeIndex &haplotypeIndex,
+    const string &pattern,
+    Sink &sink)
+{
+    scanHaplotypes(edText, haplotypeIndex, pattern, SegmentSinkCollector<Sink>{ sink });
+}
+
+template<typename Alphabet>
+unordered_map<int, typename BasicSopang<Alphabet>::SourceSet> BasicSopang<Alphabet>::matchWithSourcesHaplotype(const EdText &edText,
+    const HaplotypeIndex &haplotypeIndex,
+    const string &pattern)
+{
+    SegmentSourcesCollector collector(haplotypeIndex.sourceCount());
+    scanHaplotypes(edText, haplotypeIndex, pattern, ref(collector));
+
+    return move(collector.res);
+}
+
+template<typename Alphabet>
+int BasicSopang<Alphabet>::countMatchingSourcesHaplotype(const EdText &edText,
+    const HaplotypeIndex &haplotypeIndex,
+    const string &pattern)
+{
+    SourceCounter counter(haplotypeIndex.sourceCount());
+    scanHaplotypes(edText, haplotypeIndex, pattern, ref(counter));
+
+    return counter.count();
+}
+
+template<typename Alphabet>
+template<typename OnSegment>
+void BasicSopang<Alphabet>::scanHaplotypes(const EdText &edText,
+    const HaplotypeIndex &haplotypeIndex,
+    const string &pattern,
+    OnSegment onSegment)
+{
+    assert(pattern.size() > 0 and pattern.size() <= maxPatternHaplotypeSize);
+    fillPatternMaskBuffer(pattern);
+
+    const size_t m = pattern.size();
+    const uint64_t hitMask = (0x1ULL << (m - 1));
+    // States without active proper prefixes of the pattern are equivalent to the initial one and are not carried over.
+    const uint64_t carryMask = hitMask - 1;
+
+    const int sourceCount = haplotypeIndex.sourceCount();
+    haplotypeLanes.clear();
+
+    for (int iB = 0; iB < haplotypeIndex.nBlocks(); ++iB)
+    {
+        const int blockBegin = haplotypeIndex.blockBegin(iB);
+        const int blockSize = haplotypeIndex.blockEnd(iB) - blockBegin;
+
+        blockSources.assign(blockSize, SourceSet(sourceCount));
+        blockDeterministicMatches.assign(blockSize, 0);
+
+        nextHaplotypeLanes.clear();
+
+        for (int iC = haplotypeIndex.classBegin(iB); iC < haplotypeIndex.classEnd(iB); ++iC)
+        {
+            const char *text = haplotypeIndex.classText(iC);
+            const size_t size = haplotypeIndex.classSize(iC);
+            const size_t *segmentEnds = haplotypeIndex.classSegmentEnds(iC);
+
+            const auto scanClass = [&](uint64_t D, const SourceSet &sources) {
+                int iS = 0;
+
+                for (size_t i = 0; i < size; ++i)
+                {
+                    D <<= 1;
+                    D |= maskBuffer[Alphabet::code(text[i])];
+
+                    if ((D & hitMask) == 0x0ULL)
+                    {
+                        while (segmentEnds[iS] <= i)
+                        {
+                            iS += 1;
+                        }
+
+                        const size_t segmentStart = (iS == 0) ? 0 : segmentEnds[iS - 1];
+
+                        if (edText.segmentSize(blockBegin + iS) == 1 and i + 1 >= segmentStart + m)
+                        {
+                            blockDeterministicMatches[iS] = 1;
+                        }
+                        else
+                        {
+                            blockSources[iS] |= sources;
+                        }
+                    }
+                }
+
+                if ((~D & carryMask) != 0x0ULL)
+                {
+                    nextHaplotypeLanes.push_back({ sources, D });
+                }
+            };
+
+            const SourceSet &classSources = haplotypeIndex.classSources(iC);
+            SourceSet carriedSources(sourceCount);
+
+            for (const HaplotypeLane &lane : haplotypeLanes)
+            {
+                const SourceSet laneSources = (lane.sources & classSources);
+
+                if (laneSources.any())
+                {
+                    scanClass(lane.D, laneSources);
+                    carriedSources |= laneSources;
+                }
+            }
+
+            // The remaining class sources enter the block with the initial state.
+            if (not carriedSources.any())
+            {
+                scanClass(allOnes, classSources);
+            }
+            else if (carriedSources.count() < classSources.count())
+            {
+                carriedSources.flip();
+                scanClass(allOnes, carriedSources & classSources);
+            }
+        }
+
+        // Lanes with the same state are merged, hence their number is bounded by the number of distinct states rather than by the number of paths.
+        sort(nextHaplotypeLanes.begin(), nextHaplotypeLanes.end(), [](const HaplotypeLane &lane1, const HaplotypeLane &lane2) { return lane1.D < lane2.D; });
+        haplotypeLanes.clear();
+
+        for (HaplotypeLane &lane : nextHaplotypeLanes)
+        {
+            if (not haplotypeLanes.empty() and haplotypeLanes.back().D == lane.D)
+            {
+                haplotypeLanes.back().sources |= lane.sources;
+            }
+            else
+            {
+                haplotypeLanes.push_back(move(lane));
+            }
+        }
+
+        for (int iS = 0; iS < blockSize; ++iS)
+        {
+            if (blockDeterministicMatches[iS] != 0 or blockSources[iS].any())
+            {
+                if (not onSegment(blockBegin + iS, blockSources[iS], blockDeterministicMatches[iS] != 0))
+                    return;
+            }
+        }
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchWithSourcesVerifyPbwt(const EdText &edText,
+    const PbwtIndex &pbwtIndex,
+    const string &pattern)
 {
-    dBuffer = new uint64_t[dBufferSize];
-    initCounterPositionMasks();
+    SortedVectorSink sink;
+    matchWithSourcesVerifyPbwt(edText, pbwtIndex, pattern, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchWithSourcesVerifyPbwt(const EdText &edText,
+    const PbwtIndex &pbwtIndex,
+    const string &pattern,
+    Sink &sink)
+{
+    scanCandidates(edText, pattern, [&](int segmentIdx, const vector<pair<int, int>> &matches) {
+        for (const auto &match : matches)
+        {
+            if (verifyMatchPbwt(edText, pbwtIndex, pattern, segmentIdx, match))
+            {
+                sink(segmentIdx);
+                break;
+            }
+        }
+
+        return not sink.full();
+    });
+}
+
+template<typename Alphabet>
+bool BasicSopang<Alphabet>::verifyMatchPbwt(const EdText &edText,
+    const PbwtIndex &pbwtIndex,
+    const string &pattern,
+    int matchIdx,
+    const pair<int, int> &match)
+{
+    // Characters of the variant in which the match ends are the same for all paths.
+    int patternIdx = static_cast<int>(pattern.size()) - 1;
+    int nErrors = 0;
+
+    verifyVariantApprox(pattern, 0, edText.variantBegin(matchIdx, match.first), match.second + 1, patternIdx, nErrors);
+
+    if (nErrors > 0)
+        return false;
+
+    const int matchColumn = pbwtIndex.column(matchIdx);
+
+    // A match within a deterministic segment occurs in all sources.
+    if (patternIdx < 0 and matchColumn < 0)
+        return true;
+
+    PbwtIndex::Interval interval = pbwtIndex.fullInterval();
+
+    if (matchColumn >= 0)
+    {
+        interval = pbwtIndex.extend(interval, matchColumn, match.first);
+
+        if (interval.empty())
+            return false;
+    }
+
+    pbwtStates.clear();
+    pbwtStates.push_back(PbwtState{ matchIdx, patternIdx, interval });
+
+    while (not pbwtStates.empty())
+    {
+        const PbwtState state = pbwtStates.back();
+        pbwtStates.pop_back();
+
+        if (state.patternIdx < 0)
+            return true;
+
+        if (state.segmentIdx == 0)
+            continue;
+
+        const int iS = state.segmentIdx - 1;
+        const int column = pbwtIndex.column(iS);
+
+        for (int variantIdx = 0; variantIdx < edText.segmentSize(iS); ++variantIdx)
+        {
+            int curPatternIdx = state.patternIdx;
+            int curErrors = 0;
+
+            verifyVariantApprox(pattern, 0, edText.variantBegin(iS, variantIdx), edText.variantSize(iS, variantIdx), curPatternIdx, curErrors);
+
+            if (curErrors > 0)
+                continue;
+
+            if (column < 0)
+            {
+                pbwtStates.push_back(PbwtState{ iS, curPatternIdx, state.interval });
+                continue;
+            }
+
+            const PbwtIndex::Interval curInterval = pbwtIndex.extend(state.interval, column, variantIdx);
+
+            if (not curInterval.empty())
+            {
+                pbwtStates.push_back(PbwtState{ iS, curPatternIdx, curInterval });
+            }
+        }
+    }
+
+    return false;
 }
 
-Sopang::~Sopang()
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchApproxWithSourcesVerify(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k)
+{
+    SortedVectorSink sink;
+    matchApproxWithSourcesVerify(edText, sourceMap, sourceCount, pattern, k, sink);
+
+    return unordered_set<int>(sink.indexes.begin(), sink.indexes.end());
+}
+
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::matchApproxWithSourcesVerify(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k,
+    Sink &sink)
+{
+    scanMatchSources(edText, sourceMap, sourceCount, pattern, k, true, SegmentSinkCollector<Sink>{ sink });
+}
+
+template<typename Alphabet>
+unordered_map<int, typename BasicSopang<Alphabet>::SourceSet> BasicSopang<Alphabet>::matchApproxWithSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const string &pattern,
+    int k)
 {
-    delete[] dBuffer;
+    SegmentSourcesCollector collector(sourceCount);
+    scanMatchSources(edText, sourceMap, sourceCount, pattern, k, false, ref(collector));
+
+    return move(collector.res);
 }
 
-unordered_set<int> Sopang::match(const string *const *segments,
-    int nSegments,
-    const int *segmentSizes,
-    const string &pattern)
+template<typename Alphabet>
+template<typename OnSegment>
+void BasicSopang<Alphabet>::scanCandidates(const EdText &edText,
+    const string &pattern,
+    OnSegment onSegment)
 {
-    assert(nSegments > 0 and pattern.size() > 0 and pattern.size() <= wordSize);
+    assert(edText.nSegments() > 0 and pattern.size() > 0 and pattern.size() <= maxPatternSize);
 
-    fillPatternMaskBuffer(pattern);
-
-    const uint64_t hitMask = (0x1ULL << (pattern.size() - 1));
-    uint64_t D = allOnes;
+    // [(variant index, char in variant index)] for the current segment.
+    vector<pair<int, int>> segmentMatches;
 
-    unordered_set<int> res;
+    // Reachable sources and breadcrumbs depend on the pattern, hence they are valid for a single query.
+    clearSourcesMemo();
+    liveVariantsValid = false;
 
-    for (int iS = 0; iS < nSegments; ++iS)
+    if (pattern.size() > wordSize)
     {
-        assert(segmentSizes[iS] > 0 and static_cast<size_t>(segmentSizes[iS]) <= dBufferSize);
-
-        for (int iD = 0; iD < segmentSizes[iS]; ++iD)
-        {
-            dBuffer[iD] = D;
+        int lastIdx = -1;
+        bool stopped = false;
 
-            for (size_t iC = 0; iC < segments[iS][iD].size(); ++iC)
+        scanMultiWordDispatch(edText, pattern, [&](int iS, int iV, int iC) {
+            if (iS != lastIdx and not segmentMatches.empty())
             {
-                const char c = segments[iS][iD][iC];
-
-                assert(c > 0 and static_cast<unsigned char>(c) < maskBufferSize);
-                assert(alphabet.find(c) != string::npos);
-
-                dBuffer[iD] <<= 1;
-                dBuffer[iD] |= maskBuffer[static_cast<unsigned char>(c)];
-
-                // Match occurred. Note: we still continue in order to fill the whole d-buffer.
-                if ((dBuffer[iD] & hitMask) == 0x0ULL)
-                {
-                    res.insert(iS);
-                }
+                stopped = not onSegment(lastIdx, segmentMatches);
+                segmentMatches.clear();
             }
-        }
 
-        D = dBuffer[0];
+            lastIdx = iS;
+            segmentMatches.emplace_back(iV, iC);
 
-        for (int iD = 1; iD < segmentSizes[iS]; ++iD)
+            return not stopped;
+        });
+
+        if (not stopped and not segmentMatches.empty())
         {
-            // As a join operation we want to preserve 0s (active states):
-            // a match can occur in any segment alternative.
-            D &= dBuffer[iD];
+            onSegment(lastIdx, segmentMatches);
         }
-    }
 
-    return res;
-}
-
-unordered_set<int> Sopang::matchApprox(const string *const *segments,
-    int nSegments,
-    const int *segmentSizes,
-    const string &pattern,
-    int k)
-{
-    assert(nSegments > 0 and pattern.size() > 0 and pattern.size() <= maxPatternApproxSize);
-    assert(k > 0);
+        return;
+    }
 
-    unordered_set<int> res;
+    fillPatternMaskBuffer(pattern);
 
-    fillPatternMaskBufferApprox(pattern);
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
 
-    // This is the initial position of each counter, after k + 1 errors the most significant bit will be set.
-    const uint64_t counterMask = 0xFULL - k;
-    // Hit mask indicates whether the most significant bit in the last counter is set.
-    const uint64_t hitMask = (0x1ULL << ((pattern.size() * saCounterSize) - 1));
+    const int nSegments = edText.nSegments();
 
-    uint64_t D = 0x0ULL;
+    const uint64_t hitMask = (0x1ULL << (pattern.size() - 1));
+    // Bits of all pattern prefixes, the shift overflows to 0 for a full word which yields all ones as well.
+    const uint64_t prefixMask = (hitMask << 1) - 1;
+    uint64_t D = allOnes;
 
-    for (size_t i = 0; i < pattern.size(); ++i)
+    if (breadcrumbsEnabled)
     {
-        // We initialize the state with full counters which allow us to effectively start matching
-        // after m characters.
-        D |= (saFullCounter << (i * saCounterSize));
+        liveVariants.assign((segmentOffsets[nSegments] + wordSize - 1) / wordSize, 0x0ULL);
+        liveVariantsValid = true;
     }
 
     for (int iS = 0; iS < nSegments; ++iS)
     {
-        assert(segmentSizes[iS] > 0 and static_cast<size_t>(segmentSizes[iS]) <= dBufferSize);
+        uint64_t joinD = allOnes;
 
-        for (int iD = 0; iD < segmentSizes[iS]; ++iD)
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
         {
-            dBuffer[iD] = D;
+            uint64_t curD = D;
+            const char *variant = chars + variantOffsets[iV];
 
-            for (size_t iC = 0; iC < segments[iS][iD].size(); ++iC)
+            for (const char *c = variant; c != chars + variantOffsets[iV + 1]; ++c)
             {
-                const char c = segments[iS][iD][iC];
-
-                assert(c > 0 and static_cast<unsigned char>(c) < maskBufferSize);
-                assert(alphabet.find(c) != string::npos);
-
-                dBuffer[iD] <<= saCounterSize;
-                dBuffer[iD] += counterMask;
+                curD <<= 1;
+                curD |= maskBuffer[Alphabet::code(*c)];
 
-                dBuffer[iD] += maskBuffer[static_cast<unsigned char>(c)];
-
-                if ((dBuffer[iD] & hitMask) == 0x0ULL)
+                if ((curD & hitMask) == 0x0ULL)
                 {
-                    res.insert(iS);
+                    segmentMatches.emplace_back(iV - segmentOffsets[iS], static_cast<int>(c - variant));
                 }
             }
-        }
-
-        D = 0x0ULL;
-
-        // As a join operation, we take the minimum (the most promising alternative) from each counter.
-        for (size_t i = 0; i < pattern.size(); ++i)
-        {
-            uint64_t min = (dBuffer[0] & counterPosMasks[i]);
 
-            for (int iD = 1; iD < segmentSizes[iS]; ++iD)
+            if (breadcrumbsEnabled)
             {
-                uint64_t cur = (dBuffer[iD] & counterPosMasks[i]);
-                
-                if (cur < min)
-                {
-                    min = cur;
-                }
+                // Branchless, since live and dead variants are interleaved unpredictably.
+                liveVariants[iV / wordSize] |= (static_cast<uint64_t>((~curD & prefixMask) != 0x0ULL) << (iV % wordSize));
             }
 
-            D |= min;
+            joinD &= curD;
         }
-    }
 
-    return res;
-}
+        if (not segmentMatches.empty())
+        {
+            if (not onSegment(iS, segmentMatches))
+                return;
 
-namespace
-{
+            segmentMatches.clear();
+        }
 
-bool verifyMatch(const string *const *segments,
-    const int *segmentSizes,
-    const Sopang::SourceMap &sourceMap,
-    int sourceCount,
-    const string &pattern,
-    int matchIdx,
-    const pair<int, int> &match)
-{
-    using SourceSet = Sopang::SourceSet;
-    const int patternCharIdx = static_cast<int>(pattern.size()) - match.second - 2;
+        D = joinD;
+    }
+}
 
-    if (patternCharIdx < 0) // The match is fully contained within a single segment.
-        return true;
+template<typename Alphabet>
+template<typename Sink>
+uint64_t BasicSopang<Alphabet>::scanSegments(const EdText &edText,
+    int beginIdx,
+    int endIdx,
+    uint64_t D,
+    uint64_t hitMask,
+    Sink &sink) const
+{
+    assert(beginIdx >= 0 and beginIdx <= endIdx and endIdx <= edText.nSegments());
 
-    vector<pair<SourceSet, int>> leaves;
-    SourceSet rootSources(sourceCount);
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
 
-    if (sourceMap.count(matchIdx) > 0)
-    {
-        rootSources = sourceMap.at(matchIdx)[match.first];
-    }
-    else
+    for (int iS = beginIdx; iS < endIdx; ++iS)
     {
-        rootSources.set();
-    }
+        // As a join operation we want to preserve 0s (active states):
+        // a match can occur in any segment alternative.
+        uint64_t joinD = allOnes;
+        // Accumulates states after each character, the hit bit is cleared if a match occurred anywhere in the segment.
+        uint64_t hitD = allOnes;
 
-    leaves.emplace_back(move(rootSources), patternCharIdx);
-    int segmentIdx = static_cast<int>(matchIdx - 1);
-
-    while (not leaves.empty() and segmentIdx >= 0)
-    {
-        if (segmentSizes[segmentIdx] == 1)
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
         {
-            for (auto &leaf : leaves)
+            // The state for the current variant is kept in a register rather than in the d-buffer.
+            uint64_t curD = D;
+
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
             {
-                leaf.second -= segments[segmentIdx][0].size();
+                curD <<= 1;
+                curD |= maskBuffer[Alphabet::code(*c)];
 
-                if (leaf.second < 0)
-                    return true;
+                hitD &= curD;
             }
+
+            joinD &= curD;
         }
-        else
+
+        if ((hitD & hitMask) == 0x0ULL)
         {
-            assert(sourceMap.count(segmentIdx) > 0 and sourceMap.at(segmentIdx).size() == static_cast<size_t>(segmentSizes[segmentIdx]));
+            sink(iS);
 
-            vector<pair<SourceSet, int>> newLeaves;
-            newLeaves.reserve(leaves.size() * segmentSizes[segmentIdx]);
+            if (sink.full())
+                return joinD;
+        }
 
-            for (const auto &leaf : leaves)
-            {
-                for (int variantIdx = 0; variantIdx < segmentSizes[segmentIdx]; ++variantIdx)
-                {
-                    const SourceSet &variantSources = sourceMap.at(segmentIdx)[variantIdx];
+        D = joinD;
+    }
 
-                    if (segments[segmentIdx][variantIdx].empty())
-                    {
-                        const SourceSet newSources = (variantSources & leaf.first);
+    return D;
+}
 
-                        if (newSources.any())
-                        {
-                            newLeaves.emplace_back(move(newSources), leaf.second);
-                        }
-                    }
-                    else
-                    {
-                        int curCharIdx = static_cast<int>(segments[segmentIdx][variantIdx].size()) - 1;
-                        int curPatternIdx = static_cast<int>(leaf.second);
+template<typename Alphabet>
+template<size_t M, typename Sink>
+void BasicSopang<Alphabet>::scanSegmentsFixed(const EdText &edText,
+    Sink &sink) const
+{
+    static_assert(M > 0 and M <= wordSize, "fixed pattern size must fit in a single word");
+    using Word = FixedStateWord<M>;
 
-                        while (curCharIdx >= 0)
-                        {
-                            if (curPatternIdx < 0)
-                            {
-                                const SourceSet newSources = (variantSources & leaf.first);
+    constexpr Word wordAllOnes = static_cast<Word>(~static_cast<Word>(0));
+    constexpr Word hitMask = static_cast<Word>(static_cast<Word>(1) << (M - 1));
 
-                                if (newSources.any())
-                                    return true;
-                            }
+    // Bits above M - 1 are never tested, hence the masks can be truncated to the state type.
+    Word masks[maskBufferSize];
 
-                            if (pattern[curPatternIdx] != segments[segmentIdx][variantIdx][curCharIdx])
-                                break;
+    for (size_t code = 0; code < maskBufferSize; ++code)
+    {
+        masks[code] = static_cast<Word>(maskBuffer[code]);
+    }
 
-                            curCharIdx -= 1;
-                            curPatternIdx -= 1;
-                        }
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
 
-                        if (curPatternIdx < 0)
-                        {
-                            const SourceSet newSources = (variantSources & leaf.first);
+    const int nSegments = edText.nSegments();
+    Word D = wordAllOnes;
 
-                            if (newSources.any())
-                                return true;
-                        }
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        Word joinD = wordAllOnes;
+        Word hitD = wordAllOnes;
 
-                        if (curCharIdx < 0)
-                        {
-                            const SourceSet newSources = (variantSources & leaf.first);
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            Word curD = D;
 
-                            if (newSources.any())
-                            {
-                                newLeaves.emplace_back(move(newSources), curPatternIdx);
-                            }
-                        }
-                    }
-                }
+            for (const char *c = chars + variantOffsets[iV]; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                curD = static_cast<Word>((curD << 1) | masks[Alphabet::code(*c)]);
+                hitD &= curD;
             }
 
-            leaves = newLeaves;
+            joinD &= curD;
+        }
+
+        if ((hitD & hitMask) == 0)
+        {
+            sink(iS);
+
+            if (sink.full())
+                return;
         }
 
-        segmentIdx -= 1;
+        D = joinD;
     }
+}
 
-    return false;
+template<typename Alphabet>
+template<typename Sink>
+void BasicSopang<Alphabet>::scanSegmentsDispatch(const EdText &edText,
+    size_t patternSize,
+    Sink &sink) const
+{
+    switch (patternSize)
+    {
+        case 8:
+            scanSegmentsFixed<8>(edText, sink);
+            break;
+        case 16:
+            scanSegmentsFixed<16>(edText, sink);
+            break;
+        case 32:
+            scanSegmentsFixed<32>(edText, sink);
+            break;
+        case 64:
+            scanSegmentsFixed<64>(edText, sink);
+            break;
+        default:
+            scanSegments(edText, 0, edText.nSegments(), allOnes, (0x1ULL << (patternSize - 1)), sink);
+            break;
+    }
 }
 
-Sopang::SourceSet calcMatchSources(const string *const *segments,
-    const int *segmentSizes,
-    const Sopang::SourceMap &sourceMap,
-    int sourceCount,
-    const string &pattern,
-    int matchIdx,
-    const pair<int, int> &match,
-    bool &deterministicSegmentMatch)
+template<typename Alphabet>
+vector<int> BasicSopang<Alphabet>::calcChunkBounds(const EdText &edText,
+    size_t patternSize,
+    int nChunks,
+    vector<bool> &anchored) const
 {
-    using SourceSet = Sopang::SourceSet;
-    const int patternCharIdx = static_cast<int>(pattern.size()) - match.second - 2;
+    assert(patternSize > 0 and nChunks > 0);
 
-    if (patternCharIdx < 0) // The match is fully contained within a single segment.
-    {
-        if (sourceMap.count(matchIdx) > 0)
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
+
+    const int nSegments = edText.nSegments();
+    const size_t textSize = edText.size();
+
+    // Returns the first segment starting at or after character [charIdx] (or nSegments), segments are searched starting from [firstIdx].
+    const auto findSegment = [&](size_t charIdx, int firstIdx) {
+        int lo = firstIdx, hi = nSegments;
+
+        while (lo < hi)
         {
-            assert(match.first >= 0 and match.first < static_cast<int>(sourceMap.at(matchIdx).size()));
-            return sourceMap.at(matchIdx)[match.first];
-        }
+            const int mid = lo + (hi - lo) / 2;
 
-        deterministicSegmentMatch = true;
-        return SourceSet(sourceCount);
-    }
+            if (variantOffsets[segmentOffsets[mid]] < charIdx)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
 
-    vector<pair<SourceSet, int>> leaves;
-    SourceSet rootSources(sourceCount);
-    
-    if (sourceMap.count(matchIdx) > 0)
-    {
-        assert(match.first >= 0 and match.first < static_cast<int>(sourceMap.at(matchIdx).size()));
-        rootSources = sourceMap.at(matchIdx)[match.first];
-    }
-    else
-    {
-        rootSources.set();
-    }
+        return lo;
+    };
 
-    leaves.emplace_back(move(rootSources), patternCharIdx);
-    int segmentIdx = static_cast<int>(matchIdx - 1);
+    // A deterministic segment of at least m - 1 characters determines all state bits which can lead to a match later on.
+    const auto isAnchor = [&](int iS) {
+        return edText.segmentSize(iS) == 1 and static_cast<size_t>(edText.variantSize(iS, 0)) + 1 >= patternSize;
+    };
 
-    SourceSet res(sourceCount);
+    vector<int> bounds { 0 };
+    // The first chunk starts with the initial state, hence it does not require reconciliation.
+    anchored.assign(1, true);
 
-    while (not leaves.empty() and segmentIdx >= 0)
+    for (int iC = 1; iC < nChunks; ++iC)
     {
-        vector<pair<SourceSet, int>> newLeaves;
-        newLeaves.reserve(leaves.size() * segmentSizes[segmentIdx]);
+        // Chunks are balanced with respect to the number of characters rather than segments.
+        const int cutIdx = findSegment(textSize * iC / nChunks, bounds.back() + 1);
+        const int limitIdx = findSegment(textSize * (iC + 1) / nChunks, cutIdx);
 
-        if (segmentSizes[segmentIdx] == 1)
-        {
-            for (auto &leaf : leaves)
-            {
-                leaf.second -= segments[segmentIdx][0].size();
+        if (cutIdx >= nSegments)
+            break;
 
-                if (leaf.second < 0)
-                {
-                    res |= leaf.first;
-                }
-                else
-                {
-                    newLeaves.push_back(leaf);
-                }
-            }
+        // We look for the closest anchor before the next cut, a chunk starts right after it.
+        int anchorIdx = max(cutIdx - 1, bounds.back());
 
-            leaves = newLeaves;
+        while (anchorIdx + 1 < limitIdx and not isAnchor(anchorIdx))
+        {
+            anchorIdx += 1;
+        }
+
+        if (anchorIdx + 1 < nSegments and isAnchor(anchorIdx))
+        {
+            bounds.push_back(anchorIdx + 1);
+            anchored.push_back(true);
         }
         else
         {
-            assert(sourceMap.count(segmentIdx) > 0 and sourceMap.at(segmentIdx).size() == static_cast<size_t>(segmentSizes[segmentIdx]));
+            bounds.push_back(cutIdx);
+            anchored.push_back(false);
+        }
+    }
 
-            for (const auto &leaf : leaves)
-            {
-                for (int variantIdx = 0; variantIdx < segmentSizes[segmentIdx]; ++variantIdx)
-                {
-                    const SourceSet &variantSources = sourceMap.at(segmentIdx)[variantIdx];
+    bounds.push_back(nSegments);
+    return bounds;
+}
 
-                    if (segments[segmentIdx][variantIdx].empty())
-                    {
-                        const SourceSet newSources = (variantSources & leaf.first);
+template<typename Alphabet>
+template<size_t N, typename OnHit>
+void BasicSopang<Alphabet>::scanMultiWord(const EdText &edText, const string &pattern, OnHit onHit) const
+{
+    assert(pattern.size() > (N - 1) * wordSize and pattern.size() <= N * wordSize);
 
-                        if (newSources.any())
-                        {
-                            newLeaves.emplace_back(move(newSources), leaf.second);
-                        }
-                    }
-                    else
-                    {
-                        int curCharIdx = static_cast<int>(segments[segmentIdx][variantIdx].size()) - 1;
-                        int curPatternIdx = static_cast<int>(leaf.second);
+    MultiWord<N> masks[maskBufferSize];
+    fillPatternMaskBufferMultiWord(pattern, masks);
 
-                        while (curCharIdx >= 0)
-                        {
-                            if (curPatternIdx < 0)
-                                break;
+    const char *chars = edText.charData();
+    const size_t *variantOffsets = edText.variantOffsetData();
+    const int *segmentOffsets = edText.segmentOffsetData();
 
-                            if (pattern[curPatternIdx] != segments[segmentIdx][variantIdx][curCharIdx])
-                                break;
+    const int nSegments = edText.nSegments();
+    const size_t hitBit = pattern.size() - 1;
 
-                            curCharIdx -= 1;
-                            curPatternIdx -= 1;
-                        }
+    MultiWord<N> D = MultiWord<N>::filled(true);
 
-                        if (curPatternIdx < 0)
-                        {
-                            const SourceSet newSources = (variantSources & leaf.first);
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        MultiWord<N> joinD = MultiWord<N>::filled(true);
 
-                            if (newSources.any())
-                            {
-                                res |= newSources;
-                                continue;
-                            }
-                        }
+        for (int iV = segmentOffsets[iS]; iV < segmentOffsets[iS + 1]; ++iV)
+        {
+            MultiWord<N> curD = D;
+            const char *variant = chars + variantOffsets[iV];
 
-                        if (curCharIdx < 0)
-                        {
-                            const SourceSet newSources = (variantSources & leaf.first);
+            for (const char *c = variant; c != chars + variantOffsets[iV + 1]; ++c)
+            {
+                curD.shiftOr(masks[Alphabet::code(*c)]);
 
-                            if (newSources.any())
-                            {
-                                newLeaves.emplace_back(move(newSources), curPatternIdx);
-                            }
-                        }
-                    }
-                }
+                if (not curD.test(hitBit) and not onHit(iS, iV - segmentOffsets[iS], static_cast<int>(c - variant)))
+                    return;
             }
 
-            leaves = newLeaves;
+            joinD &= curD;
         }
 
-        segmentIdx -= 1;
+        D = joinD;
     }
-
-    return res;
 }
 
-} // namespace (anonymous)
+template<typename Alphabet>
+template<typename OnHit>
+void BasicSopang<Alphabet>::scanMultiWordDispatch(const EdText &edText, const string &pattern, OnHit onHit) const
+{
+    static_assert(maxPatternSize == 4 * wordSize, "dispatch has to cover all multi-word state sizes");
 
-unordered_set<int> Sopang::matchWithSourcesVerify(const string *const *segments,
+    switch ((pattern.size() + wordSize - 1) / wordSize)
+    {
+        case 2:
+            scanMultiWord<2>(edText, pattern, onHit);
+            break;
+        case 3:
+            scanMultiWord<3>(edText, pattern, onHit);
+            break;
+        case 4:
+            scanMultiWord<4>(edText, pattern, onHit);
+            break;
+        default:
+            assert(false);
+    }
+}
+
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::match(const string *const *segments,
     int nSegments,
     const int *segmentSizes,
-    const Sopang::SourceMap &sourceMap,
-    int sourceCount,
     const string &pattern)
 {
-    const IndexToMatchMap indexToMatch = calcIndexToMatchMap(segments, nSegments, segmentSizes, pattern);
-    unordered_set<int> res;
-
-    for (const auto &kv : indexToMatch)
-    {
-        for (const auto &match : kv.second)
-        {
-            if (verifyMatch(segments, segmentSizes, sourceMap, sourceCount, pattern, kv.first, match))
-            {
-                res.insert(kv.first);
-                break;
-            }
-        }
-    }
+    return match(EdText(segments, nSegments, segmentSizes), pattern);
+}
 
-    return res;
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchApprox(const string *const *segments,
+    int nSegments,
+    const int *segmentSizes,
+    const string &pattern,
+    int k)
+{
+    return matchApprox(EdText(segments, nSegments, segmentSizes), pattern, k);
 }
 
-unordered_map<int, Sopang::SourceSet> Sopang::matchWithSources(const string *const *segments,
+template<typename Alphabet>
+unordered_set<int> BasicSopang<Alphabet>::matchWithSourcesVerify(const string *const *segments,
     int nSegments,
     const int *segmentSizes,
-    const Sopang::SourceMap &sourceMap,
+    const SourceMap &sourceMap,
     int sourceCount,
     const string &pattern)
 {
-    const IndexToMatchMap indexToMatch = calcIndexToMatchMap(segments, nSegments, segmentSizes, pattern);
-
-    unordered_map<int, SourceSet> res;
-
-    for (const auto &kv : indexToMatch)
-    {
-        for (const auto &match : kv.second)
-        {
-            bool deterministicSegmentMatch = false;
-            const SourceSet curSources = calcMatchSources(segments, segmentSizes, sourceMap, sourceCount, pattern, kv.first, match, deterministicSegmentMatch);
-
-            if (not curSources.empty())
-            {
-                if (res.count(kv.first) > 0)
-                {
-                    res.find(kv.first)->second |= curSources;
-                }
-                else
-                {
-                    res.emplace(kv.first, move(curSources));
-                }
-            }
-            else if (deterministicSegmentMatch)
-            {
-                res.emplace(kv.first, sourceCount);
-            }
-        }
-    }
-
-    return res;
+    return matchWithSourcesVerify(EdText(segments, nSegments, segmentSizes), sourceMap, sourceCount, pattern);
 }
 
-Sopang::IndexToMatchMap Sopang::calcIndexToMatchMap(const string *const *segments,
+template<typename Alphabet>
+unordered_map<int, typename BasicSopang<Alphabet>::SourceSet> BasicSopang<Alphabet>::matchWithSources(const string *const *segments,
     int nSegments,
     const int *segmentSizes,
+    const SourceMap &sourceMap,
+    int sourceCount,
     const string &pattern)
 {
-    assert(nSegments > 0 and pattern.size() > 0 and pattern.size() <= wordSize);
-    fillPatternMaskBuffer(pattern);
+    return matchWithSources(EdText(segments, nSegments, segmentSizes), sourceMap, sourceCount, pattern);
+}
 
-    const uint64_t hitMask = (0x1ULL << (pattern.size() - 1));
-    uint64_t D = allOnes;
+template<typename Alphabet>
+typename BasicSopang<Alphabet>::BatchLayout BasicSopang<Alphabet>::calcBatchLayout(const vector<string> &patterns) const
+{
+    BatchLayout layout;
+    vector<pair<size_t, size_t>> slots; // (word index, bit offset) for each pattern.
 
-    // segment index -> [(variant index, char in variant index)]
-    IndexToMatchMap res;
-    res.reserve(matchMapReserveSize);
+    size_t wordIdx = 0, bitOffset = 0;
 
-    for (int iS = 0; iS < nSegments; ++iS)
+    // Patterns are packed greedily in the input order, a pattern is never split between words.
+    for (const string &pattern : patterns)
     {
-        assert(segmentSizes[iS] > 0 and static_cast<size_t>(segmentSizes[iS]) <= dBufferSize);
+        assert(pattern.size() > 0 and pattern.size() <= wordSize);
 
-        for (int iD = 0; iD < segmentSizes[iS]; ++iD)
+        if (bitOffset + pattern.size() > wordSize)
         {
-            dBuffer[iD] = D;
+            wordIdx += 1;
+            bitOffset = 0;
+        }
 
-            for (size_t iC = 0; iC < segments[iS][iD].size(); ++iC)
-            {
-                const char c = segments[iS][iD][iC];
+        slots.emplace_back(wordIdx, bitOffset);
+        bitOffset += pattern.size();
+    }
 
-                assert(c > 0 and static_cast<unsigned char>(c) < maskBufferSize);
-                assert(alphabet.find(c) != string::npos);
+    layout.nWords = wordIdx + 1;
 
-                dBuffer[iD] <<= 1;
-                dBuffer[iD] |= maskBuffer[static_cast<unsigned char>(c)];
+    layout.masks.assign(maskBufferSize * layout.nWords, allOnes);
+    layout.startMasks.assign(layout.nWords, 0x0ULL);
+    layout.hitMasks.assign(layout.nWords, 0x0ULL);
+    layout.hitPatterns.assign(layout.nWords * wordSize, -1);
 
-                if ((dBuffer[iD] & hitMask) == 0x0ULL)
-                {
-                    res[iS].emplace_back(iD, static_cast<int>(iC));
-                }
-            }
-        }
+    for (size_t iP = 0; iP < patterns.size(); ++iP)
+    {
+        const size_t iW = slots[iP].first;
+        const size_t offset = slots[iP].second;
 
-        D = dBuffer[0];
+        layout.startMasks[iW] |= (0x1ULL << offset);
+        layout.hitMasks[iW] |= (0x1ULL << (offset + patterns[iP].size() - 1));
+        layout.hitPatterns[iW * wordSize + offset + patterns[iP].size() - 1] = static_cast<int>(iP);
 
-        for (int iD = 1; iD < segmentSizes[iS]; ++iD)
+        for (size_t iC = 0; iC < patterns[iP].size(); ++iC)
         {
-            D &= dBuffer[iD];
+            assert(Alphabet::isValid(patterns[iP][iC]));
+            layout.masks[Alphabet::code(patterns[iP][iC]) * layout.nWords + iW] &= (~(0x1ULL << (offset + iC)));
         }
     }
 
-    return res;
+    return layout;
 }
 
-void Sopang::initCounterPositionMasks()
+template<typename Alphabet>
+void BasicSopang<Alphabet>::fillPatternMaskBuffer(const string &pattern)
 {
-    for (size_t i = 0; i < maxPatternApproxSize; ++i)
+    assert(pattern.size() > 0 and pattern.size() <= wordSize);
+
+    // All codes are reset (rather than only the alphabet symbols), the mask buffer is tiny.
+    for (size_t code = 0; code < maskBufferSize; ++code)
+    {
+        maskBuffer[code] = allOnes;
+    }
+
+    for (size_t iC = 0; iC < pattern.size(); ++iC)
     {
-        counterPosMasks[i] = (saCounterAllSet << (i * saCounterSize));
+        assert(Alphabet::isValid(pattern[iC]));
+        maskBuffer[Alphabet::code(pattern[iC])] &= (~(0x1ULL << iC));
     }
 }
 
-void Sopang::fillPatternMaskBuffer(const string &pattern)
+template<typename Alphabet>
+template<size_t N>
+void BasicSopang<Alphabet>::fillPatternMaskBufferMultiWord(const string &pattern, MultiWord<N> *masks) const
 {
-    assert(pattern.size() > 0 and pattern.size() <= wordSize);
-    assert(alphabet.size() > 0);
+    assert(pattern.size() > 0 and pattern.size() <= N * wordSize);
 
-    for (const char c : alphabet)
+    for (size_t code = 0; code < maskBufferSize; ++code)
     {
-        assert(c > 0 and static_cast<unsigned char>(c) < maskBufferSize);
-        maskBuffer[static_cast<unsigned char>(c)] = allOnes;
+        masks[code] = MultiWord<N>::filled(true);
     }
 
     for (size_t iC = 0; iC < pattern.size(); ++iC)
     {
-        assert(pattern[iC] > 0 and static_cast<unsigned char>(pattern[iC]) < maskBufferSize);
-        maskBuffer[static_cast<unsigned char>(pattern[iC])] &= (~(0x1ULL << iC));
+        assert(Alphabet::isValid(pattern[iC]));
+        masks[Alphabet::code(pattern[iC])].reset(iC);
     }
 }
 
-void Sopang::fillPatternMaskBufferApprox(const string &pattern)
+template<typename Alphabet>
+void BasicSopang<Alphabet>::fillPatternMaskBufferApprox(const string &pattern)
 {
     assert(pattern.size() > 0 and pattern.size() <= wordSize);
-    assert(alphabet.size() > 0);
 
-    for (const char c : alphabet)
+    for (size_t code = 0; code < maskBufferSize; ++code)
     {
-        assert(c > 0 and static_cast<unsigned char>(c) < maskBufferSize);
-        maskBuffer[static_cast<unsigned char>(c)] = 0x0ULL;
+        maskBuffer[code] = 0x0ULL;
 
         for (size_t iC = 0; iC < pattern.size(); ++iC)
         {
-            maskBuffer[static_cast<unsigned char>(c)] |= (0x1ULL << (iC * saCounterSize));
+            maskBuffer[code] |= (0x1ULL << (iC * saCounterSize));
         }
     }
 
     for (size_t iC = 0; iC < pattern.size(); ++iC)
     {
-        assert(pattern[iC] > 0 and static_cast<unsigned char>(pattern[iC]) < maskBufferSize);
+        assert(Alphabet::isValid(pattern[iC]));
         // We zero the bit at the counter position corresponding to the current character in the pattern.
-        maskBuffer[static_cast<unsigned char>(pattern[iC])] &= (~(0x1ULL << (iC * saCounterSize)));
+        maskBuffer[Alphabet::code(pattern[iC])] &= (~(0x1ULL << (iC * saCounterSize)));
     }
 }
 
+template<typename Alphabet>
+template<size_t B>
+void BasicSopang<Alphabet>::fillPatternMaskBufferApproxMultiWord(const string &pattern, size_t nWords)
+{
+    constexpr size_t countersPerWord = wordSize / B;
+    assert(pattern.size() > 0 and nWords <= maxApproxWords and pattern.size() <= nWords * countersPerWord);
+
+    for (size_t code = 0; code < maskBufferSize; ++code)
+    {
+        uint64_t *masks = approxMaskBuffer + code * maxApproxWords;
+        fill(masks, masks + nWords, 0x0ULL);
+
+        for (size_t iC = 0; iC < pattern.size(); ++iC)
+        {
+            masks[iC / countersPerWord] |= (0x1ULL << ((iC % countersPerWord) * B));
+        }
+    }
+
+    for (size_t iC = 0; iC < pattern.size(); ++iC)
+    {
+        assert(Alphabet::isValid(pattern[iC]));
+        // We zero the bit at the counter position corresponding to the current character in the pattern.
+        approxMaskBuffer[Alphabet::code(pattern[iC]) * maxApproxWords + iC / countersPerWord] &= (~(0x1ULL << ((iC % countersPerWord) * B)));
+    }
+}
+
+template class BasicSopang<DnaAlphabet>;
+template class BasicSopang<ProteinAlphabet>;
+
+#define SOPANG_INSTANTIATE_SINK(Alphabet, Sink) \
+    template void BasicSopang<Alphabet>::match<Sink>(const EdText &, const string &, Sink &); \
+    template void BasicSopang<Alphabet>::matchParallel<Sink>(const EdText &, const string &, int, Sink &); \
+    template void BasicSopang<Alphabet>::matchBatch<Sink>(const EdText &, const vector<string> &, vector<Sink> &); \
+    template void BasicSopang<Alphabet>::matchApprox<Sink>(const EdText &, const string &, int, Sink &); \
+    template void BasicSopang<Alphabet>::matchApproxFiltered<Sink>(const EdText &, const string &, int, Sink &); \
+    template void BasicSopang<Alphabet>::matchEdit<Sink>(const EdText &, const string &, int, Sink &); \
+    template void BasicSopang<Alphabet>::matchWithSourcesVerify<Sink>(const EdText &, const SourceMap &, int, const string &, Sink &); \
+    template void BasicSopang<Alphabet>::matchWithSourcesVerifyForward<Sink>(const EdText &, const SourceMap &, int, const string &, Sink &); \
+    template void BasicSopang<Alphabet>::matchWithSourcesVerifyHaplotype<Sink>(const EdText &, const HaplotypeIndex &, const string &, Sink &); \
+    template void BasicSopang<Alphabet>::matchWithSourcesVerifyPbwt<Sink>(const EdText &, const PbwtIndex &, const string &, Sink &); \
+    template void BasicSopang<Alphabet>::matchApproxWithSourcesVerify<Sink>(const EdText &, const SourceMap &, int, const string &, int, Sink &);
+
+#define SOPANG_INSTANTIATE_SINKS(Alphabet) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, SortedVectorSink) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, BitmapSink) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, CallbackSink) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, CountSink) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, ExistsSink) \
+    SOPANG_INSTANTIATE_SINK(Alphabet, FirstNSink)
+
+SOPANG_INSTANTIATE_SINKS(DnaAlphabet)
+SOPANG_INSTANTIATE_SINKS(ProteinAlphabet)
+
+#undef SOPANG_INSTANTIATE_SINKS
+#undef SOPANG_INSTANTIATE_SINK
+
 } // namespace sopang
@@ -1,10 +1,20 @@
 #ifndef SOPANG_HPP
 #define SOPANG_HPP
 
-#include "bitset.hpp"
+#include "alphabet.hpp"
+#include "ed_text.hpp"
+#include "haplotype_index.hpp"
+#include "multi_word.hpp"
+#include "pbwt_index.hpp"
+#include "result_sink.hpp"
+#include "source_map.hpp"
+#include "source_set.hpp"
+#include "thread_pool.hpp"
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -17,18 +27,237 @@
 namespace sopang
 {
 
-class Sopang
+/** Shift-Or based matcher over ED text, [Alphabet] is one of the alphabets from alphabet.hpp. */
+template<typename Alphabet>
+class BasicSopang
 {
-private:
-    /** Maximum number of sources (upper bound on source set size). */
-    static constexpr int maxSourceCount = 5'120;
-
 public:
-    using SourceSet = BitSet<maxSourceCount>;
-    using SourceMap = std::unordered_map<int, std::vector<SourceSet>>;
+    /** Maximum pattern size for approximate search, patterns longer than maxPatternApproxSingleWordSize use multi-word counters. */
+    static constexpr size_t maxPatternApproxSize = 128;
+    /** Maximum number of errors for approximate search. */
+    static constexpr int maxApproxErrors = 127;
+    /** Maximum pattern size for approximate search under the edit distance. */
+    static constexpr size_t maxPatternEditSize = 64;
+    /** Maximum number of errors for approximate search under the edit distance, the automaton keeps k + 1 states. */
+    static constexpr int maxEditErrors = 16;
+    /** Maximum pattern size for the forward engine for matching with sources, the state fits in a single word. */
+    static constexpr size_t maxPatternSourcesForwardSize = 64;
+    /** Maximum pattern size for matching with sources over haplotype blocks, the state fits in a single word. */
+    static constexpr size_t maxPatternHaplotypeSize = 64;
+
+    using SourceSet = sopang::SourceSet;
+    using SourceMap = sopang::SourceMap;
+    using HaplotypeIndex = sopang::HaplotypeIndex;
+    using PbwtIndex = sopang::PbwtIndex;
+
+    /** Grows the scratch buffer used for joining segment variants so that it fits segments of up to [maxSegmentSize] variants.
+     * The buffer never shrinks, hence calling this once after loading the text avoids allocations during subsequent queries. */
+    void reserveScratch(int maxSegmentSize);
+
+    /** Enables breadcrumbs for exact matching with sources (patterns up to 64 characters): the forward scan marks variants
+     * after which any pattern prefix is active, and backward verification visits only the marked variants. Disabled by default. */
+    void setBreadcrumbs(bool enabled) { breadcrumbsEnabled = enabled; }
+
+    std::unordered_set<int> match(const EdText &edText,
+        const std::string &pattern);
+
+    /** Sink overloads deliver indexes of matching segments to [sink] in increasing order, each index once.
+     * Sink is one of the sinks from result_sink.hpp, the search stops early once the sink is full (e.g. ExistsSink, FirstNSink). */
+    template<typename Sink>
+    void match(const EdText &edText,
+        const std::string &pattern,
+        Sink &sink);
+
+    /** Searches for all [patterns] in a single pass over [edText], i-th result corresponds to i-th pattern.
+     * Patterns are packed into bit slots of 64-bit Shift-Or words, so that short patterns share the text scan. */
+    std::vector<std::unordered_set<int>> matchBatch(const EdText &edText,
+        const std::vector<std::string> &patterns);
+
+    /** Indexes for the i-th pattern are delivered to [sinks][i], a full sink receives no further indexes and the scan stops once all sinks are full. */
+    template<typename Sink>
+    void matchBatch(const EdText &edText,
+        const std::vector<std::string> &patterns,
+        std::vector<Sink> &sinks);
 
-    Sopang(const std::string &alphabet);
-    ~Sopang();
+    /** Same as match, but the segments of [edText] are split into chunks which are scanned by [nThreads] threads.
+     * Chunks start after deterministic segments of at least m - 1 characters when possible, as the Shift-Or state
+     * following such a segment does not depend on the preceding text. Remaining chunk boundaries are repaired
+     * by a sequential reconciliation pass. Patterns longer than wordSize are matched by a single thread.
+     * Chunks are scanned on a thread pool owned by the instance and each chunk is delivered as soon as all preceding chunks are scanned,
+     * hence [sink] is called from the pool threads (one at a time) and the remaining chunks are skipped once it is full. */
+    std::unordered_set<int> matchParallel(const EdText &edText,
+        const std::string &pattern,
+        int nThreads);
+
+    template<typename Sink>
+    void matchParallel(const EdText &edText,
+        const std::string &pattern,
+        int nThreads,
+        Sink &sink);
+
+    /** Approximate matching under the Hamming distance, up to [k] mismatches are allowed.
+     * Patterns up to maxPatternApproxSingleWordSize use a single word with 5-bit counters, longer patterns (or larger [k])
+     * use multi-word states with 5-bit (up to 16 characters) or 8-bit (up to maxPatternApproxSize characters) counters. */
+    std::unordered_set<int> matchApprox(const EdText &edText,
+        const std::string &pattern,
+        int k);
+
+    template<typename Sink>
+    void matchApprox(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        Sink &sink);
+
+    /** Approximate matching under the Hamming distance which returns, for each segment containing a match with up to [kMax] mismatches,
+     * the smallest number of mismatches among matches ending in that segment. Hence a single scan answers the queries for all k <= kMax,
+     * the result of matchApprox for k consists of segments with the distance at most k. */
+    std::unordered_map<int, int> matchApproxMinDistance(const EdText &edText,
+        const std::string &pattern,
+        int kMax);
+
+    /** Same result as matchApprox, computed with a pigeonhole filter: [pattern] is split into k + 1 pieces, at least one of which
+     * occurs exactly in each match. Pieces are found with a single batched exact scan, and only the windows of segments around
+     * piece occurrences are verified with Shift-Add. Falls back to matchApprox if pieces would be shorter than minFilterPieceSize. */
+    std::unordered_set<int> matchApproxFiltered(const EdText &edText,
+        const std::string &pattern,
+        int k);
+
+    template<typename Sink>
+    void matchApproxFiltered(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        Sink &sink);
+
+    /** Approximate matching under the edit (Levenshtein) distance, up to [k] substitutions, insertions and deletions are allowed.
+     * Uses the bit-parallel automaton of Wu and Manber with k + 1 Shift-Or states, each of which is joined separately across variants. */
+    std::unordered_set<int> matchEdit(const EdText &edText,
+        const std::string &pattern,
+        int k);
+
+    template<typename Sink>
+    void matchEdit(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        Sink &sink);
+
+    std::unordered_set<int> matchWithSourcesVerify(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    template<typename Sink>
+    void matchWithSourcesVerify(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        Sink &sink);
+
+    std::unordered_map<int, SourceSet> matchWithSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    /** Returns the number of sources in which [pattern] occurs without building per-segment source sets.
+     * Matches within a deterministic segment occur in all sources, the search stops once all sources are found. */
+    int countMatchingSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    /** Forward engine for matching with sources, same results as matchWithSourcesVerify. A single Shift-Or pass carries a source set
+     * for each active pattern prefix: sets are restricted to variant sources at the start of each variant and united in the segment join,
+     * hence candidates are not verified backwards. Supports patterns up to maxPatternSourcesForwardSize characters. */
+    std::unordered_set<int> matchWithSourcesVerifyForward(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    template<typename Sink>
+    void matchWithSourcesVerifyForward(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        Sink &sink);
+
+    /** Forward engine counterpart of matchWithSources. */
+    std::unordered_map<int, SourceSet> matchWithSourcesForward(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    /** Forward engine counterpart of countMatchingSources. */
+    int countMatchingSourcesForward(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern);
+
+    /** Matching with sources over [haplotypeIndex] built for [edText], same results as matchWithSourcesVerify. The text of each class
+     * of a block is scanned once with plain Shift-Or and matches are credited to all class sources. States with active prefixes are carried
+     * to the next block together with their sources, which are split among its classes. Supports patterns up to maxPatternHaplotypeSize characters. */
+    std::unordered_set<int> matchWithSourcesVerifyHaplotype(const EdText &edText,
+        const HaplotypeIndex &haplotypeIndex,
+        const std::string &pattern);
+
+    template<typename Sink>
+    void matchWithSourcesVerifyHaplotype(const EdText &edText,
+        const HaplotypeIndex &haplotypeIndex,
+        const std::string &pattern,
+        Sink &sink);
+
+    /** Haplotype block counterpart of matchWithSources. */
+    std::unordered_map<int, SourceSet> matchWithSourcesHaplotype(const EdText &edText,
+        const HaplotypeIndex &haplotypeIndex,
+        const std::string &pattern);
+
+    /** Haplotype block counterpart of countMatchingSources. */
+    int countMatchingSourcesHaplotype(const EdText &edText,
+        const HaplotypeIndex &haplotypeIndex,
+        const std::string &pattern);
+
+    /** Matching with sources using [pbwtIndex] built for [edText], same results as matchWithSourcesVerify. Candidates from the Shift-Or scan
+     * are verified backwards along each path consistent with the pattern, the path narrows an interval of the PBWT orderings rather than
+     * intersecting source sets, hence verification takes time proportional to the path length rather than to the number of sources.
+     * Sources of matches are not reported, since the number of such paths is exponential in the number of segments spanned by a match,
+     * matchWithSources and countMatchingSources share reachable sources between matches instead. */
+    std::unordered_set<int> matchWithSourcesVerifyPbwt(const EdText &edText,
+        const PbwtIndex &pbwtIndex,
+        const std::string &pattern);
+
+    template<typename Sink>
+    void matchWithSourcesVerifyPbwt(const EdText &edText,
+        const PbwtIndex &pbwtIndex,
+        const std::string &pattern,
+        Sink &sink);
+
+    /** Approximate counterpart of matchWithSourcesVerify: [pattern] has to occur with up to [k] mismatches (Hamming distance)
+     * along a path consistent with at least one source. Candidates from the Shift-Add scan are verified backwards
+     * through source sets while carrying the remaining mismatch budget. */
+    std::unordered_set<int> matchApproxWithSourcesVerify(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k);
+
+    template<typename Sink>
+    void matchApproxWithSourcesVerify(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k,
+        Sink &sink);
+
+    /** Approximate counterpart of matchWithSources, returns sources for each segment containing a match with up to [k] mismatches. */
+    std::unordered_map<int, SourceSet> matchApproxWithSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k);
+
+    /*
+     *** SEGMENT ARRAY INTERFACE
+     */
+
+    // These overloads accept the output of parsing::parseTextArray and convert it to the flat layout on each call.
 
     std::unordered_set<int> match(const std::string *const *segments,
         int nSegments,
@@ -56,53 +285,339 @@ public:
         const std::string &pattern);
 
 private:
-    using IndexToMatchMap = std::unordered_map<int, std::vector<std::pair<int, int>>>;
+    /** Finds match candidates for verification with sources, [onSegment] is called with (segment index, [(variant index, char in variant index)])
+     * for each segment containing matches in increasing order. The scan stops when [onSegment] returns false. */
+    template<typename OnSegment>
+    void scanCandidates(const EdText &edText,
+        const std::string &pattern,
+        OnSegment onSegment);
 
-    IndexToMatchMap calcIndexToMatchMap(const std::string *const *segments,
-        int nSegments,
-        const int *segmentSizes,
-        const std::string &pattern);
+    /** Single-word exact Shift-Or over segments [beginIdx, endIdx) starting from state [D], requires a filled mask buffer.
+     * Indexes of segments containing matches are passed to [sink] in increasing order, the state after the last segment is returned. */
+    template<typename Sink>
+    uint64_t scanSegments(const EdText &edText,
+        int beginIdx,
+        int endIdx,
+        uint64_t D,
+        uint64_t hitMask,
+        Sink &sink) const;
+
+    /** Narrowest unsigned type which holds a single-word Shift-Or state for a pattern of [M] characters. */
+    template<size_t M>
+    using FixedStateWord = std::conditional_t<M <= 8, uint8_t,
+        std::conditional_t<M <= 16, uint16_t,
+        std::conditional_t<M <= 32, uint32_t, uint64_t>>>;
+
+    /** Same as scanSegments over the whole text, specialized for the pattern size [M] known at compile time.
+     * The state is kept in FixedStateWord<M> and the hit test is a constant, requires a filled mask buffer. */
+    template<size_t M, typename Sink>
+    void scanSegmentsFixed(const EdText &edText,
+        Sink &sink) const;
+
+    /** Picks a fixed-size kernel for the common pattern sizes (8, 16, 32, 64) and falls back to scanSegments otherwise. */
+    template<typename Sink>
+    void scanSegmentsDispatch(const EdText &edText,
+        size_t patternSize,
+        Sink &sink) const;
+
+    /** Returns chunkPool with [nThreads] threads, (re)creating it if needed. */
+    ThreadPool &calcChunkPool(int nThreads);
+
+    /** Splits segments of [edText] into at most [nChunks] chunks for matchParallel, returns chunk start indexes followed by nSegments.
+     * [anchored] is set for each chunk whose start state can be recomputed from the preceding (anchor) segment alone. */
+    std::vector<int> calcChunkBounds(const EdText &edText,
+        size_t patternSize,
+        int nChunks,
+        std::vector<bool> &anchored) const;
+
+    /** Patterns packed into consecutive bit slots of 64-bit Shift-Or words. */
+    struct BatchLayout
+    {
+        size_t nWords = 0;
+
+        /** Shift-Or masks, [c * nWords + wordIdx] for character c. */
+        std::vector<uint64_t> masks;
+        /** Bits corresponding to the first pattern character of each slot. */
+        std::vector<uint64_t> startMasks;
+        /** Bits corresponding to the last pattern character of each slot. */
+        std::vector<uint64_t> hitMasks;
+        /** Pattern index for the last character bit of each slot, [wordIdx * wordSize + bitIdx]. */
+        std::vector<int> hitPatterns;
+    };
+
+    BatchLayout calcBatchLayout(const std::vector<std::string> &patterns) const;
+
+    /** Shift-Or over N-word states for patterns longer than wordSize, [onHit] is called with (segment index, variant index, char in variant index).
+     * The scan stops when [onHit] returns false. */
+    template<size_t N, typename OnHit>
+    void scanMultiWord(const EdText &edText, const std::string &pattern, OnHit onHit) const;
+    /** Calls scanMultiWord with N corresponding to the size of [pattern]. */
+    template<typename OnHit>
+    void scanMultiWordDispatch(const EdText &edText, const std::string &pattern, OnHit onHit) const;
+
+    template<size_t N>
+    void fillPatternMaskBufferMultiWord(const std::string &pattern, MultiWord<N> *masks) const;
+
+    /** Backward engine counterpart of scanWithSources for [pattern] with up to [k] mismatches, k = 0 for exact matching, [onSegment] is called
+     * in the same way. Candidates of each segment are verified with calcMatchSources and their sources are summed, if [anySources] is set
+     * only until the first candidate which occurs in any source. */
+    template<typename OnSegment>
+    void scanMatchSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k,
+        bool anySources,
+        OnSegment onSegment);
+
+    /** Returns sources for which [pattern] occurs with up to [k] mismatches ending at [match] in segment [matchIdx], k = 0 for exact matching.
+     * [deterministicSegmentMatch] is set if the match is contained within a single deterministic segment (i.e. it occurs in all sources).
+     * Requires a preceding scanCandidates or scanCandidatesApprox for [pattern] and [k], which clears sourcesMemo. */
+    SourceSet calcMatchSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k,
+        int matchIdx,
+        const std::pair<int, int> &match,
+        bool &deterministicSegmentMatch);
+
+    void clearSourcesMemo() { sourcesMemo.clear(); sourcesMemoBytes = 0; }
+
+    /** Returns sources for which the pattern prefix up to the pattern index from [key] occurs ending at the end of segment [segmentIdx]
+     * with the number of mismatches from [key] carried over, key = pattern index * (k + 1) + number of mismatches.
+     * Results are memoized in sourcesMemo, hence backward walks of neighboring candidates share the preceding segments.
+     * States which are not memoized yet are discovered going backwards and then resolved in the reverse order, without recursion. */
+    const SourceSet &calcReachableSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        int k,
+        int segmentIdx,
+        int key);
+
+    /** States of calcReachableSources discovered for a single segment. */
+    struct SourcesFrontier
+    {
+        /** Keys of states present in the frontier, in insertion order. */
+        std::vector<int> keys;
+        /** Whether the state with a given key is present. */
+        std::vector<uint8_t> present;
+    };
+
+    /** Runs the forward engine for matching with sources over the whole text, [onSegment] is called with (segment index, sources,
+     * whether the match is contained within a single deterministic segment) for each segment containing matches in increasing order.
+     * Sources are empty for deterministic segment matches, which occur in all sources. The scan stops when [onSegment] returns false. */
+    template<typename OnSegment>
+    void scanWithSources(const EdText &edText,
+        const SourceMap &sourceMap,
+        int sourceCount,
+        const std::string &pattern,
+        OnSegment onSegment);
+
+    /** Shift-Or state carried between haplotype blocks for [sources] which share it. */
+    struct HaplotypeLane
+    {
+        SourceSet sources;
+        uint64_t D;
+    };
+
+    /** Haplotype block counterpart of scanWithSources, [onSegment] is called in the same way. */
+    template<typename OnSegment>
+    void scanHaplotypes(const EdText &edText,
+        const HaplotypeIndex &haplotypeIndex,
+        const std::string &pattern,
+        OnSegment onSegment);
+
+    /** Verifies [match] ending in segment [matchIdx] backwards along paths until the first one having sources, returns true if there is one. */
+    bool verifyMatchPbwt(const EdText &edText,
+        const PbwtIndex &pbwtIndex,
+        const std::string &pattern,
+        int matchIdx,
+        const std::pair<int, int> &match);
+
+    /** Path of verifyMatchPbwt which starts in segment [segmentIdx] and has the pattern matched down to [patternIdx] + 1. */
+    struct PbwtState
+    {
+        int segmentIdx;
+        int patternIdx;
+        PbwtIndex::Interval interval;
+    };
+
+    /** Approximate counterpart of scanCandidates, a candidate is a position in which [pattern] ends with up to [k] mismatches
+     * along at least one path. Multi-word states are used for all pattern sizes, since hits are checked after each character. */
+    template<typename OnSegment>
+    void scanCandidatesApprox(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        OnSegment onSegment);
+
+    template<size_t B, typename OnSegment>
+    void scanCandidatesApproxMultiWord(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        OnSegment onSegment);
+
+    /** Initializes [nWords] words of a multi-word Shift-Add state [D] with full counters. */
+    template<size_t B>
+    static void initApproxMultiWord(uint64_t *D, size_t nWords);
+
+    /** Single Shift-Add step for a character with [masks] over a multi-word state [D] of [nWords] words. */
+    template<size_t B>
+    static void shiftAddMultiWord(uint64_t *D, const uint64_t *masks, size_t nWords, uint64_t counterStart);
+
+    /** Shift-Add over multi-word states with [B]-bit counters, supports patterns up to 2^(B - 1) characters and k < 2^(B - 1).
+     * A counter never overflows into its neighbor, hence counters are added word by word without carries between words. */
+    template<size_t B, typename Sink>
+    void matchApproxMultiWord(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        Sink &sink);
+
+    /** Same as matchApproxMultiWord, but the last counter is minimized over the characters of each segment rather than only tested. */
+    template<size_t B>
+    void matchApproxMinDistanceMultiWord(const EdText &edText,
+        const std::string &pattern,
+        int kMax,
+        std::unordered_map<int, int> &res);
+
+    /** Multi-word Shift-Add over segments [beginIdx, endIdx) starting from the initial state, requires a filled approximate mask buffer. */
+    template<size_t B, typename Sink>
+    void scanApproxMultiWord(const EdText &edText,
+        int beginIdx,
+        int endIdx,
+        size_t patternSize,
+        int k,
+        Sink &sink) const;
+
+    /** Returns sorted disjoint windows [begin, end) of segments which may contain matches of [pattern] with up to [k] mismatches,
+     * i.e. segments around exact occurrences of the k + 1 pattern pieces. */
+    std::vector<std::pair<int, int>> calcFilterWindows(const EdText &edText,
+        const std::string &pattern,
+        int k);
+
+    /** Runs Shift-Add with [B]-bit counters separately over each of the [windows]. */
+    template<size_t B, typename Sink>
+    void verifyFilterWindows(const EdText &edText,
+        const std::string &pattern,
+        int k,
+        const std::vector<std::pair<int, int>> &windows,
+        Sink &sink);
+
+    /** Returns a word with the most significant bit of each [B]-bit counter set, counters are packed wordSize / B per word. */
+    template<size_t B>
+    static constexpr uint64_t calcCounterHighBits();
 
-    void initCounterPositionMasks();
+    /** Counter-wise minimum of [x] and [y] holding packed [B]-bit counters, computed with a constant number of word operations (SWAR). */
+    template<size_t B>
+    static uint64_t minCounters(uint64_t x, uint64_t y);
 
     void fillPatternMaskBuffer(const std::string &pattern);
     void fillPatternMaskBufferApprox(const std::string &pattern);
+    /** Fills approxMaskBuffer with [nWords] words per code, counters of [B] bits are packed wordSize / B per word. */
+    template<size_t B>
+    void fillPatternMaskBufferApproxMultiWord(const std::string &pattern, size_t nWords);
 
-    /** Buffer size for processing segment variants, the size of the largest segment (i.e. the number of variants)
-     * from the input file cannot be larger than this value. */
-    static constexpr size_t dBufferSize = 262'144;
-    /** Buffer size for Shift-Or masks for the input alphabet, must be larger than the largest input character ASCII code, 
-     * up to 'Z' = 90. */
-    static constexpr size_t maskBufferSize = 91;
+    /** Buffer size for Shift-Or masks for the input alphabet, masks are indexed by symbol codes. */
+    static constexpr size_t maskBufferSize = Alphabet::codeCount;
     /** Word size (in bits) used by the Shift-Or algorithm. */
     static constexpr size_t wordSize = 64;
+    /** Maximum pattern size for exact matching, patterns longer than wordSize are handled with multi-word states. */
+    static constexpr size_t maxPatternSize = 4 * wordSize;
 
-    /** Maximum pattern size for approximate search. */
-    static constexpr size_t maxPatternApproxSize = 12;
+    /** Maximum pattern size for approximate search with a single word. */
+    static constexpr size_t maxPatternApproxSingleWordSize = 12;
+    /** Minimum pattern piece size for which matchApproxFiltered uses the filter. */
+    static constexpr size_t minFilterPieceSize = 8;
+    /** Maximum number of words of a multi-word Shift-Add state, with 8-bit counters. */
+    static constexpr size_t maxApproxWords = maxPatternApproxSize / (wordSize / 8);
     /** Shift-Add counter size in bits. */
     static constexpr size_t saCounterSize = 5;
     
     /** Full single Shift-Add counter indicating no match. */
     static constexpr uint64_t saFullCounter = 0x10ULL;
-    /** Single Shift-Add counter with all bits set. */
-    static constexpr uint64_t saCounterAllSet = 0x20ULL - 0x1ULL;
     /** Counter with all bits set. */
     static constexpr uint64_t allOnes = ~(0x0ULL);
 
-    /** Initial memory reserve size for a map storing matches for verification with sources. */
-    static constexpr size_t matchMapReserveSize = 32;
+    /** Total size of memoized reachable source sets after which the memo is cleared between candidates, this bounds the memory used by a single query. */
+    static constexpr size_t maxSourcesMemoBytes = 256 << 20;
 
-    uint64_t counterPosMasks[maxPatternApproxSize];
-
-    uint64_t *dBuffer;
+    /** Scratch buffer for processing segment variants, holds a state for each variant of the current segment.
+     * Grown on demand to the largest segment size, owned by a single instance and thus by a single thread. */
+    std::vector<uint64_t> dBuffer;
     uint64_t maskBuffer[maskBufferSize];
+    /** Multi-word Shift-Add masks, maxApproxWords words for each code. */
+    uint64_t approxMaskBuffer[maskBufferSize * maxApproxWords];
+    /** Current and next frontier of calcReachableSources, grown on demand and reused across calls like dBuffer. */
+    SourcesFrontier frontiers[2];
+    /** (segment index, key) of states discovered by calcReachableSources, in the discovery order. */
+    std::vector<std::pair<int, int>> pendingStates;
+    /** Reachable sources for (segment index * number of keys + key) computed during the current query. */
+    std::unordered_map<uint64_t, SourceSet> sourcesMemo;
+    /** Sum of SourceSet::sizeInBytes over sourcesMemo. */
+    size_t sourcesMemoBytes = 0;
+
+    /** Source sets of the forward engine, wordSize slots for each of: the state before the current segment, the current variant and the join. */
+    std::vector<SourceSet> forwardSlots;
+
+    /** Lanes entering and leaving the current haplotype block. */
+    std::vector<HaplotypeLane> haplotypeLanes, nextHaplotypeLanes;
+    /** Sources for each segment of the current haplotype block, and whether it contains a deterministic segment match. */
+    std::vector<SourceSet> blockSources;
+    std::vector<uint8_t> blockDeterministicMatches;
+
+    /** Threads scanning text chunks in matchParallel, kept across queries. */
+    std::unique_ptr<ThreadPool> chunkPool;
+
+    /** Paths pending in verifyMatchPbwt. */
+    std::vector<PbwtState> pbwtStates;
 
-    const std::string alphabet;
-    int sourceCount;
+    bool breadcrumbsEnabled = false;
+    /** Set if liveVariants were recorded by the last scan for verification with sources. */
+    bool liveVariantsValid = false;
+    /** A bit for each variant of the text (indexed as in EdText::variantOffsetData), set if any pattern prefix is active after the variant. */
+    std::vector<uint64_t> liveVariants;
 
     SOPANG_WHITEBOX
 };
 
+template<typename Alphabet>
+template<size_t B>
+constexpr uint64_t BasicSopang<Alphabet>::calcCounterHighBits()
+{
+    static_assert(B > 1 and B < wordSize, "counter size must be in [2, wordSize)");
+    uint64_t res = 0x0ULL;
+
+    for (size_t i = 0; i < wordSize / B; ++i)
+    {
+        res |= (0x1ULL << (i * B + B - 1));
+    }
+
+    return res;
+}
+
+template<typename Alphabet>
+template<size_t B>
+inline uint64_t BasicSopang<Alphabet>::minCounters(uint64_t x, uint64_t y)
+{
+    constexpr uint64_t highBits = calcCounterHighBits<B>();
+    constexpr uint64_t counterAllSet = (0x1ULL << B) - 1;
+
+    // Counter-wise x - y computed without borrows between counters: the high bit of each counter is subtracted separately.
+    const uint64_t diff = ((x | highBits) - (y & ~highBits)) ^ ((x ^ ~y) & highBits);
+    // Borrow out of the high bit of each counter (full subtractor), set iff the counter in x is smaller than the one in y.
+    const uint64_t lessBits = ((~x & y) | (~(x ^ y) & diff)) & highBits;
+    // Each borrow bit is expanded to the whole counter, the product does not cross counter boundaries.
+    const uint64_t lessMask = (lessBits >> (B - 1)) * counterAllSet;
+
+    return (x & lessMask) | (y & ~lessMask);
+}
+
+using Sopang = BasicSopang<DnaAlphabet>;
+
+extern template class BasicSopang<DnaAlphabet>;
+extern template class BasicSopang<ProteinAlphabet>;
+
 } // namespace sopang
 
 #endif // SOPANG_HPP
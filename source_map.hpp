@@ -0,0 +1,154 @@
+#ifndef SOURCE_MAP_HPP
+#define SOURCE_MAP_HPP
+
+#include "source_set.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sopang
+{
+
+/** Sources of variants of non-deterministic segments stored in a flat (CSR-style) layout.
+ * Each text segment has an ordinal which is -1 for deterministic segments (i.e. ones without sources).
+ * Non-deterministic segment with ordinal o has its variant sources in [ordinalOffsets[o], ordinalOffsets[o + 1])
+ * of a single array of source sets. */
+class SourceMap
+{
+public:
+    SourceMap() = default;
+    /** Takes over [sources] (as returned by parsing::parseSources) without copying the source sets,
+     * i-th element holds sources for the i-th segment of size > 1 out of [nSegments] segments having [segmentSizes]. */
+    SourceMap(int nSegments, const int *segmentSizes, std::vector<std::vector<SourceSet>> sources);
+
+    bool empty() const { return sourceSets.empty(); }
+    /** Number of segments for which sources are stored. */
+    int nSegments() const { return static_cast<int>(ordinalOffsets.size()) - 1; }
+
+    /** Whether sources are stored for segment [segmentIdx], i.e. whether it is non-deterministic. */
+    bool hasSources(int segmentIdx) const;
+    /** Number of variants with sources in segment [segmentIdx], 0 for deterministic segments. */
+    int segmentSize(int segmentIdx) const;
+
+    /** Sources of variant [variantIdx] of non-deterministic segment [segmentIdx]. */
+    const SourceSet &sources(int segmentIdx, int variantIdx) const;
+
+    /** Fills [sourceVariants] with the variant taken by each of [sourceCount] sources in non-deterministic segment [segmentIdx],
+     * throws if a source does not occur in exactly one variant. */
+    void calcSourceVariants(int segmentIdx, int sourceCount, std::vector<int> &sourceVariants) const;
+
+    size_t sizeInBytes() const;
+
+private:
+    std::vector<int> segmentOrdinals;
+    std::vector<size_t> ordinalOffsets{ 0 };
+
+    std::vector<SourceSet> sourceSets;
+};
+
+inline SourceMap::SourceMap(int nSegments, const int *segmentSizes, std::vector<std::vector<SourceSet>> sources)
+    :segmentOrdinals(nSegments, -1)
+{
+    size_t nSourceSets = 0;
+
+    for (const std::vector<SourceSet> &segmentSources : sources)
+    {
+        nSourceSets += segmentSources.size();
+    }
+
+    sourceSets.reserve(nSourceSets);
+    ordinalOffsets.reserve(sources.size() + 1);
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        if (segmentSizes[iS] <= 1)
+            continue;
+
+        const int ordinal = static_cast<int>(ordinalOffsets.size()) - 1;
+        assert(static_cast<size_t>(ordinal) < sources.size());
+
+        segmentOrdinals[iS] = ordinal;
+
+        for (SourceSet &sourceSet : sources[ordinal])
+        {
+            sourceSets.push_back(std::move(sourceSet));
+        }
+
+        ordinalOffsets.push_back(sourceSets.size());
+        // Releases the moved-from sets early, so that the peak memory does not include both copies.
+        std::vector<SourceSet>().swap(sources[ordinal]);
+    }
+}
+
+inline bool SourceMap::hasSources(int segmentIdx) const
+{
+    assert(segmentIdx >= 0);
+    return static_cast<size_t>(segmentIdx) < segmentOrdinals.size() and segmentOrdinals[segmentIdx] >= 0;
+}
+
+inline int SourceMap::segmentSize(int segmentIdx) const
+{
+    if (not hasSources(segmentIdx))
+        return 0;
+
+    const int ordinal = segmentOrdinals[segmentIdx];
+    return static_cast<int>(ordinalOffsets[ordinal + 1] - ordinalOffsets[ordinal]);
+}
+
+inline const SourceSet &SourceMap::sources(int segmentIdx, int variantIdx) const
+{
+    assert(hasSources(segmentIdx) and variantIdx >= 0 and variantIdx < segmentSize(segmentIdx));
+    return sourceSets[ordinalOffsets[segmentOrdinals[segmentIdx]] + variantIdx];
+}
+
+inline void SourceMap::calcSourceVariants(int segmentIdx, int sourceCount, std::vector<int> &sourceVariants) const
+{
+    // The reference (last) variant is typically dense and holds the sources which are not listed for other variants,
+    // hence it is not enumerated: it is only checked to be disjoint with them and to have the remaining count.
+    const int referenceIdx = segmentSize(segmentIdx) - 1;
+    const SourceSet &referenceSources = sources(segmentIdx, referenceIdx);
+
+    sourceVariants.assign(sourceCount, referenceIdx);
+    int nListed = 0;
+
+    for (int iV = 0; iV < referenceIdx; ++iV)
+    {
+        for (const int source : sources(segmentIdx, iV).toSet())
+        {
+            if (sourceVariants[source] != referenceIdx or referenceSources.test(source))
+            {
+                throw std::runtime_error("source occurs in multiple variants, segment = " + std::to_string(segmentIdx)
+                    + ", source = " + std::to_string(source));
+            }
+
+            sourceVariants[source] = iV;
+            nListed += 1;
+        }
+    }
+
+    if (referenceSources.count() != sourceCount - nListed)
+    {
+        throw std::runtime_error("source does not occur in any variant, segment = " + std::to_string(segmentIdx));
+    }
+}
+
+inline size_t SourceMap::sizeInBytes() const
+{
+    size_t res = segmentOrdinals.size() * sizeof(int) + ordinalOffsets.size() * sizeof(size_t);
+
+    for (const SourceSet &sourceSet : sourceSets)
+    {
+        res += sourceSet.sizeInBytes();
+    }
+
+    return res;
+}
+
+} // namespace sopang
+
+#endif // SOURCE_MAP_HPP
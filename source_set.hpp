@@ -0,0 +1,842 @@
+#ifndef SOURCE_SET_HPP
+#define SOURCE_SET_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <set>
+#include <vector>
+
+namespace sopang
+{
+
+/** Set of source indexes from [0, maxCount) whose representation is picked at runtime and sized to the real source count.
+ * Up to inlineCount sources, the set is a single exact-width bitmap word stored in the object itself.
+ * Larger panels are split into chunks of chunkSize sources and each non-empty chunk is kept in a roaring-style container:
+ * a sorted array of 16-bit offsets for sparse chunks or a bitmap of the exact chunk width for dense ones.
+ * A set can also store its complement (see compact), so that dense sets such as the reference variant remain small.
+ * Set operations work directly on these representations. */
+class SourceSet
+{
+public:
+    SourceSet(int maxCount);
+    SourceSet(int maxCount, const std::initializer_list<int> &list);
+    /** The max count is set to the largest element + 1. */
+    SourceSet(const std::initializer_list<int> &list);
+
+    std::set<int> toSet() const;
+
+    bool operator==(const SourceSet &other) const;
+    bool operator==(const std::set<int> &other) const;
+
+    SourceSet operator&(const SourceSet &other) const;
+
+    SourceSet &operator|=(const SourceSet &other);
+
+    int count() const;
+
+    bool empty() const;
+    bool any() const;
+
+    bool test(int n) const;
+
+    void set();
+    void set(int n);
+
+    void reset();
+    void reset(int n);
+
+    /** Replaces the set with its complement (in constant time for container representations). */
+    void flip();
+    /** Picks the smallest representation: stores the complement if more than half of the sources are present,
+     * chooses between an array and a bitmap for each container and releases unused capacity. */
+    void compact();
+
+    /** Number of bytes occupied by the set, including heap-allocated containers. */
+    size_t sizeInBytes() const;
+
+    /** Maximum source count for which the set is stored as a single inline word. */
+    static constexpr int inlineCount = 64;
+    /** Number of sources covered by a single container. */
+    static constexpr int chunkSize = 1 << 16;
+
+private:
+    /** Sources [key * chunkSize, (key + 1) * chunkSize) stored either as sorted offsets or as a bitmap. */
+    struct Container
+    {
+        uint32_t key;
+        uint32_t cardinality;
+
+        /** Sorted offsets within the chunk, used if the bitmap is empty. */
+        std::vector<uint16_t> array;
+        /** Bitmap of the exact chunk width, non-empty for bitmap containers. */
+        std::vector<uint64_t> bitmap;
+
+        bool isBitmap() const { return not bitmap.empty(); }
+        bool contains(uint16_t offset) const;
+    };
+
+    using Containers = std::vector<Container>;
+
+    static bool keyLess(const Container &container, uint32_t key) { return container.key < key; }
+
+    bool isInline() const { return maxCount <= inlineCount; }
+    uint64_t inlineMask() const { return maxCount == 64 ? ~0x0ULL : ((0x1ULL << maxCount) - 1); }
+
+    /** Number of bitmap words for the chunk with [key], the last chunk can be narrower than chunkSize. */
+    size_t chunkWords(uint32_t key) const;
+    /** Number of sources stored in containers, i.e. ignoring the complement flag. */
+    int storedCount() const;
+
+    bool storedContains(int n) const;
+    void storedInsert(int n);
+    void storedErase(int n);
+
+    /** Converts [container] to an array or a bitmap, whichever is smaller for its cardinality. */
+    static void normalize(Container &container, size_t nWords);
+    static void countBitmap(Container &container);
+
+    static Container intersect(const Container &c1, const Container &c2, size_t nWords);
+    static Container unite(const Container &c1, const Container &c2, size_t nWords);
+    static Container subtract(const Container &c1, const Container &c2, size_t nWords);
+
+    /** Operations on the stored containers of two sets with the same max count. */
+    Containers intersectStored(const SourceSet &other) const;
+    Containers uniteStored(const SourceSet &other) const;
+    /** Returns this \ other for stored containers. */
+    Containers subtractStored(const SourceSet &other) const;
+
+    /** Returns [other] converted to the max count of this set, elements which do not fit are dropped. */
+    SourceSet withMaxCount(const SourceSet &other) const;
+
+    int maxCount;
+    /** Whether the containers store the complement of the set, never set for inline sets. */
+    bool complemented = false;
+
+    uint64_t inlineWord = 0x0ULL;
+    Containers containers;
+};
+
+inline SourceSet::SourceSet(int maxCount)
+    :maxCount(maxCount)
+{
+    assert(maxCount >= 0);
+}
+
+inline SourceSet::SourceSet(int maxCount, const std::initializer_list<int> &list)
+    :SourceSet(maxCount)
+{
+    for (const int n : list)
+    {
+        set(n);
+    }
+}
+
+inline SourceSet::SourceSet(const std::initializer_list<int> &list)
+    :SourceSet(list.size() == 0 ? 0 : *std::max_element(list.begin(), list.end()) + 1, list)
+{ }
+
+inline std::set<int> SourceSet::toSet() const
+{
+    std::set<int> ret;
+
+    if (isInline() or complemented)
+    {
+        for (int n = 0; n < maxCount; ++n)
+        {
+            if (test(n))
+            {
+                ret.insert(ret.end(), n);
+            }
+        }
+
+        return ret;
+    }
+
+    for (const Container &container : containers)
+    {
+        const int offset = static_cast<int>(container.key) * chunkSize;
+
+        for (int n = 0; n < static_cast<int>(container.bitmap.size()) * 64; ++n)
+        {
+            if (container.contains(static_cast<uint16_t>(n)))
+            {
+                ret.insert(ret.end(), offset + n);
+            }
+        }
+
+        for (const uint16_t n : container.array)
+        {
+            ret.insert(ret.end(), offset + n);
+        }
+    }
+
+    return ret;
+}
+
+inline bool SourceSet::operator==(const SourceSet &other) const
+{
+    if (maxCount != other.maxCount or isInline() or complemented != other.complemented)
+    {
+        if (maxCount == other.maxCount and isInline())
+            return inlineWord == other.inlineWord;
+
+        return toSet() == other.toSet();
+    }
+
+    if (containers.size() != other.containers.size())
+        return false;
+
+    for (size_t iC = 0; iC < containers.size(); ++iC)
+    {
+        const Container &c1 = containers[iC], &c2 = other.containers[iC];
+
+        if (c1.key != c2.key or c1.cardinality != c2.cardinality)
+            return false;
+
+        if (c1.isBitmap() == c2.isBitmap())
+        {
+            if (c1.array != c2.array or c1.bitmap != c2.bitmap)
+                return false;
+        }
+        else
+        {
+            const Container &arrayContainer = c1.isBitmap() ? c2 : c1;
+            const Container &bitmapContainer = c1.isBitmap() ? c1 : c2;
+
+            // Cardinalities are equal, hence the bitmap holds exactly the array elements if it holds all of them.
+            for (const uint16_t offset : arrayContainer.array)
+            {
+                if (not bitmapContainer.contains(offset))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+inline bool SourceSet::operator==(const std::set<int> &other) const
+{
+    return this->toSet() == other;
+}
+
+inline SourceSet SourceSet::operator&(const SourceSet &other) const
+{
+    if (other.maxCount != maxCount)
+        return *this & withMaxCount(other);
+
+    SourceSet ret(maxCount);
+
+    if (isInline())
+    {
+        ret.inlineWord = inlineWord & other.inlineWord;
+        return ret;
+    }
+
+    // Complements are resolved with De Morgan's laws, so that only the stored containers are combined.
+    if (not complemented and not other.complemented)
+    {
+        ret.containers = intersectStored(other);
+    }
+    else if (not complemented)
+    {
+        ret.containers = subtractStored(other);
+    }
+    else if (not other.complemented)
+    {
+        ret.containers = other.subtractStored(*this);
+    }
+    else
+    {
+        ret.containers = uniteStored(other);
+        ret.complemented = true;
+    }
+
+    return ret;
+}
+
+inline SourceSet &SourceSet::operator|=(const SourceSet &other)
+{
+    if (other.maxCount != maxCount)
+        return *this |= withMaxCount(other);
+
+    if (isInline())
+    {
+        inlineWord |= other.inlineWord;
+        return *this;
+    }
+
+    if (not complemented and not other.complemented)
+    {
+        containers = uniteStored(other);
+    }
+    else if (not complemented)
+    {
+        containers = other.subtractStored(*this);
+        complemented = true;
+    }
+    else if (not other.complemented)
+    {
+        containers = subtractStored(other);
+    }
+    else
+    {
+        containers = intersectStored(other);
+    }
+
+    return *this;
+}
+
+inline int SourceSet::count() const
+{
+    if (isInline())
+        return __builtin_popcountll(inlineWord);
+
+    return complemented ? maxCount - storedCount() : storedCount();
+}
+
+inline bool SourceSet::empty() const
+{
+    if (isInline())
+        return inlineWord == 0x0ULL;
+
+    return complemented ? storedCount() == maxCount : containers.empty();
+}
+
+inline bool SourceSet::any() const
+{
+    return not empty();
+}
+
+inline bool SourceSet::test(int n) const
+{
+    assert(n >= 0 and n < maxCount);
+
+    if (isInline())
+        return (inlineWord & (0x1ULL << n)) != 0x0ULL;
+
+    return storedContains(n) != complemented;
+}
+
+inline void SourceSet::set()
+{
+    containers.clear();
+
+    if (isInline())
+    {
+        inlineWord = inlineMask();
+    }
+    else
+    {
+        complemented = true;
+    }
+}
+
+inline void SourceSet::set(int n)
+{
+    assert(n >= 0 and n < maxCount);
+
+    if (isInline())
+    {
+        inlineWord |= (0x1ULL << n);
+    }
+    else if (complemented)
+    {
+        storedErase(n);
+    }
+    else
+    {
+        storedInsert(n);
+    }
+}
+
+inline void SourceSet::reset()
+{
+    containers.clear();
+
+    inlineWord = 0x0ULL;
+    complemented = false;
+}
+
+inline void SourceSet::reset(int n)
+{
+    assert(n >= 0 and n < maxCount);
+
+    if (isInline())
+    {
+        inlineWord &= (~(0x1ULL << n));
+    }
+    else if (complemented)
+    {
+        storedInsert(n);
+    }
+    else
+    {
+        storedErase(n);
+    }
+}
+
+inline void SourceSet::flip()
+{
+    if (isInline())
+    {
+        inlineWord = (~inlineWord) & inlineMask();
+    }
+    else
+    {
+        complemented = not complemented;
+    }
+}
+
+inline void SourceSet::compact()
+{
+    if (isInline())
+        return;
+
+    if (storedCount() > maxCount / 2)
+    {
+        // The stored containers are replaced with their explicit complement.
+        const uint32_t nChunks = static_cast<uint32_t>((static_cast<int64_t>(maxCount) + chunkSize - 1) / chunkSize);
+        Containers complement;
+
+        for (uint32_t key = 0, iC = 0; key < nChunks; ++key)
+        {
+            Container full { key, 0, { }, std::vector<uint64_t>(chunkWords(key), ~0x0ULL) };
+
+            // Bits past the chunk width are kept cleared.
+            const int chunkWidth = std::min(chunkSize, maxCount - static_cast<int>(key) * chunkSize);
+
+            if (chunkWidth % 64 != 0)
+            {
+                full.bitmap.back() = (0x1ULL << (chunkWidth % 64)) - 1;
+            }
+
+            full.cardinality = chunkWidth;
+
+            Container res = (iC < containers.size() and containers[iC].key == key) ? subtract(full, containers[iC++], chunkWords(key)) : full;
+
+            if (res.cardinality > 0)
+            {
+                normalize(res, chunkWords(key));
+                complement.push_back(std::move(res));
+            }
+        }
+
+        containers = std::move(complement);
+        complemented = not complemented;
+    }
+
+    for (Container &container : containers)
+    {
+        normalize(container, chunkWords(container.key));
+
+        container.array.shrink_to_fit();
+        container.bitmap.shrink_to_fit();
+    }
+
+    containers.shrink_to_fit();
+}
+
+inline size_t SourceSet::sizeInBytes() const
+{
+    size_t ret = sizeof(SourceSet) + containers.capacity() * sizeof(Container);
+
+    for (const Container &container : containers)
+    {
+        ret += container.array.capacity() * sizeof(uint16_t) + container.bitmap.capacity() * sizeof(uint64_t);
+    }
+
+    return ret;
+}
+
+inline bool SourceSet::Container::contains(uint16_t offset) const
+{
+    if (isBitmap())
+        return (bitmap[offset / 64] & (0x1ULL << (offset % 64))) != 0x0ULL;
+
+    return std::binary_search(array.begin(), array.end(), offset);
+}
+
+inline size_t SourceSet::chunkWords(uint32_t key) const
+{
+    const int chunkWidth = std::min(chunkSize, maxCount - static_cast<int>(key) * chunkSize);
+    assert(chunkWidth > 0);
+
+    return (chunkWidth + 63) / 64;
+}
+
+inline int SourceSet::storedCount() const
+{
+    int ret = 0;
+
+    for (const Container &container : containers)
+    {
+        ret += container.cardinality;
+    }
+
+    return ret;
+}
+
+inline bool SourceSet::storedContains(int n) const
+{
+    const uint32_t key = n / chunkSize;
+    const auto it = std::lower_bound(containers.begin(), containers.end(), key, keyLess);
+
+    return it != containers.end() and it->key == key and it->contains(static_cast<uint16_t>(n % chunkSize));
+}
+
+inline void SourceSet::storedInsert(int n)
+{
+    const uint32_t key = n / chunkSize;
+    const uint16_t offset = static_cast<uint16_t>(n % chunkSize);
+
+    const auto it = std::lower_bound(containers.begin(), containers.end(), key, keyLess);
+
+    if (it == containers.end() or it->key != key)
+    {
+        containers.insert(it, Container { key, 1, { offset }, { } });
+        return;
+    }
+
+    if (it->isBitmap())
+    {
+        uint64_t &word = it->bitmap[offset / 64];
+
+        if ((word & (0x1ULL << (offset % 64))) == 0x0ULL)
+        {
+            word |= (0x1ULL << (offset % 64));
+            it->cardinality += 1;
+        }
+
+        return;
+    }
+
+    // Sources are usually added in increasing order, in which case the offset is appended.
+    const auto offsetIt = std::lower_bound(it->array.begin(), it->array.end(), offset);
+
+    if (offsetIt == it->array.end() or *offsetIt != offset)
+    {
+        it->array.insert(offsetIt, offset);
+        it->cardinality += 1;
+
+        normalize(*it, chunkWords(key));
+    }
+}
+
+inline void SourceSet::storedErase(int n)
+{
+    const uint32_t key = n / chunkSize;
+    const uint16_t offset = static_cast<uint16_t>(n % chunkSize);
+
+    const auto it = std::lower_bound(containers.begin(), containers.end(), key, keyLess);
+
+    if (it == containers.end() or it->key != key or not it->contains(offset))
+        return;
+
+    if (it->isBitmap())
+    {
+        it->bitmap[offset / 64] &= (~(0x1ULL << (offset % 64)));
+    }
+    else
+    {
+        it->array.erase(std::lower_bound(it->array.begin(), it->array.end(), offset));
+    }
+
+    it->cardinality -= 1;
+
+    if (it->cardinality == 0)
+    {
+        containers.erase(it);
+    }
+}
+
+inline void SourceSet::normalize(Container &container, size_t nWords)
+{
+    // An array is used as long as it is not larger than the bitmap.
+    const bool preferBitmap = container.cardinality * sizeof(uint16_t) > nWords * sizeof(uint64_t);
+
+    if (preferBitmap and not container.isBitmap())
+    {
+        container.bitmap.assign(nWords, 0x0ULL);
+
+        for (const uint16_t offset : container.array)
+        {
+            container.bitmap[offset / 64] |= (0x1ULL << (offset % 64));
+        }
+
+        container.array = { };
+    }
+    else if (not preferBitmap and container.isBitmap())
+    {
+        container.array.clear();
+        container.array.reserve(container.cardinality);
+
+        for (size_t iW = 0; iW < container.bitmap.size(); ++iW)
+        {
+            uint64_t word = container.bitmap[iW];
+
+            while (word != 0x0ULL)
+            {
+                container.array.push_back(static_cast<uint16_t>(iW * 64 + __builtin_ctzll(word)));
+                word &= (word - 1);
+            }
+        }
+
+        container.bitmap = { };
+    }
+}
+
+inline void SourceSet::countBitmap(Container &container)
+{
+    container.cardinality = 0;
+
+    for (const uint64_t word : container.bitmap)
+    {
+        container.cardinality += __builtin_popcountll(word);
+    }
+}
+
+inline SourceSet::Container SourceSet::intersect(const Container &c1, const Container &c2, size_t nWords)
+{
+    Container ret { c1.key, 0, { }, { } };
+
+    if (c1.isBitmap() and c2.isBitmap())
+    {
+        ret.bitmap.resize(nWords);
+
+        for (size_t iW = 0; iW < nWords; ++iW)
+        {
+            ret.bitmap[iW] = c1.bitmap[iW] & c2.bitmap[iW];
+        }
+
+        countBitmap(ret);
+        normalize(ret, nWords);
+    }
+    else if (c1.isBitmap() or c2.isBitmap())
+    {
+        const Container &arrayContainer = c1.isBitmap() ? c2 : c1;
+        const Container &bitmapContainer = c1.isBitmap() ? c1 : c2;
+
+        for (const uint16_t offset : arrayContainer.array)
+        {
+            if (bitmapContainer.contains(offset))
+            {
+                ret.array.push_back(offset);
+            }
+        }
+
+        ret.cardinality = static_cast<uint32_t>(ret.array.size());
+    }
+    else
+    {
+        std::set_intersection(c1.array.begin(), c1.array.end(), c2.array.begin(), c2.array.end(), std::back_inserter(ret.array));
+        ret.cardinality = static_cast<uint32_t>(ret.array.size());
+    }
+
+    return ret;
+}
+
+inline SourceSet::Container SourceSet::unite(const Container &c1, const Container &c2, size_t nWords)
+{
+    Container ret { c1.key, 0, { }, { } };
+
+    if (not c1.isBitmap() and not c2.isBitmap())
+    {
+        std::set_union(c1.array.begin(), c1.array.end(), c2.array.begin(), c2.array.end(), std::back_inserter(ret.array));
+        ret.cardinality = static_cast<uint32_t>(ret.array.size());
+    }
+    else
+    {
+        // The result is at least as large as the bitmap operand, hence it is built as a bitmap.
+        const Container &bitmapContainer = c1.isBitmap() ? c1 : c2;
+        const Container &otherContainer = c1.isBitmap() ? c2 : c1;
+
+        ret.bitmap = bitmapContainer.bitmap;
+
+        if (otherContainer.isBitmap())
+        {
+            for (size_t iW = 0; iW < nWords; ++iW)
+            {
+                ret.bitmap[iW] |= otherContainer.bitmap[iW];
+            }
+        }
+        else
+        {
+            for (const uint16_t offset : otherContainer.array)
+            {
+                ret.bitmap[offset / 64] |= (0x1ULL << (offset % 64));
+            }
+        }
+
+        countBitmap(ret);
+    }
+
+    normalize(ret, nWords);
+    return ret;
+}
+
+inline SourceSet::Container SourceSet::subtract(const Container &c1, const Container &c2, size_t nWords)
+{
+    Container ret { c1.key, 0, { }, { } };
+
+    if (not c1.isBitmap())
+    {
+        for (const uint16_t offset : c1.array)
+        {
+            if (not c2.contains(offset))
+            {
+                ret.array.push_back(offset);
+            }
+        }
+
+        ret.cardinality = static_cast<uint32_t>(ret.array.size());
+        return ret;
+    }
+
+    ret.bitmap = c1.bitmap;
+
+    if (c2.isBitmap())
+    {
+        for (size_t iW = 0; iW < nWords; ++iW)
+        {
+            ret.bitmap[iW] &= (~c2.bitmap[iW]);
+        }
+    }
+    else
+    {
+        for (const uint16_t offset : c2.array)
+        {
+            ret.bitmap[offset / 64] &= (~(0x1ULL << (offset % 64)));
+        }
+    }
+
+    countBitmap(ret);
+    normalize(ret, nWords);
+
+    return ret;
+}
+
+inline SourceSet::Containers SourceSet::intersectStored(const SourceSet &other) const
+{
+    assert(maxCount == other.maxCount);
+    Containers ret;
+
+    for (size_t i1 = 0, i2 = 0; i1 < containers.size() and i2 < other.containers.size(); )
+    {
+        const Container &c1 = containers[i1], &c2 = other.containers[i2];
+
+        if (c1.key < c2.key)
+        {
+            i1 += 1;
+        }
+        else if (c2.key < c1.key)
+        {
+            i2 += 1;
+        }
+        else
+        {
+            Container res = intersect(c1, c2, chunkWords(c1.key));
+
+            if (res.cardinality > 0)
+            {
+                ret.push_back(std::move(res));
+            }
+
+            i1 += 1;
+            i2 += 1;
+        }
+    }
+
+    return ret;
+}
+
+inline SourceSet::Containers SourceSet::uniteStored(const SourceSet &other) const
+{
+    assert(maxCount == other.maxCount);
+    Containers ret;
+
+    size_t i1 = 0, i2 = 0;
+
+    while (i1 < containers.size() and i2 < other.containers.size())
+    {
+        const Container &c1 = containers[i1], &c2 = other.containers[i2];
+
+        if (c1.key < c2.key)
+        {
+            ret.push_back(c1);
+            i1 += 1;
+        }
+        else if (c2.key < c1.key)
+        {
+            ret.push_back(c2);
+            i2 += 1;
+        }
+        else
+        {
+            ret.push_back(unite(c1, c2, chunkWords(c1.key)));
+
+            i1 += 1;
+            i2 += 1;
+        }
+    }
+
+    ret.insert(ret.end(), containers.begin() + i1, containers.end());
+    ret.insert(ret.end(), other.containers.begin() + i2, other.containers.end());
+
+    return ret;
+}
+
+inline SourceSet::Containers SourceSet::subtractStored(const SourceSet &other) const
+{
+    assert(maxCount == other.maxCount);
+    Containers ret;
+
+    size_t i2 = 0;
+
+    for (const Container &c1 : containers)
+    {
+        while (i2 < other.containers.size() and other.containers[i2].key < c1.key)
+        {
+            i2 += 1;
+        }
+
+        if (i2 < other.containers.size() and other.containers[i2].key == c1.key)
+        {
+            Container res = subtract(c1, other.containers[i2], chunkWords(c1.key));
+
+            if (res.cardinality > 0)
+            {
+                ret.push_back(std::move(res));
+            }
+        }
+        else
+        {
+            ret.push_back(c1);
+        }
+    }
+
+    return ret;
+}
+
+inline SourceSet SourceSet::withMaxCount(const SourceSet &other) const
+{
+    SourceSet ret(maxCount);
+
+    for (const int n : other.toSet())
+    {
+        if (n < maxCount)
+        {
+            ret.set(n);
+        }
+    }
+
+    return ret;
+}
+
+} // namespace sopang
+
+#endif // SOURCE_SET_HPP
@@ -0,0 +1,160 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sopang
+{
+
+/** Persistent pool of worker threads which are created once and reused for subsequent runs.
+ * Tasks are handed out dynamically, so that workers which finish early pick up the remaining tasks. */
+class ThreadPool
+{
+public:
+    /** Task is called with (task index, worker index), worker index can be used to access per-worker state. */
+    using Task = std::function<void(int, int)>;
+
+    explicit ThreadPool(int nThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    /** Calls [task] for each task index in [0, nTasks) and blocks until all tasks are finished.
+     * If any task throws, the first exception is rethrown after all workers have stopped. */
+    void run(int nTasks, const Task &task);
+
+private:
+    void workerLoop(int workerIdx);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+
+    /** Incremented on each run, allows workers to tell a new run from a spurious wakeup. */
+    size_t runIdx = 0;
+    bool stopping = false;
+
+    const Task *curTask = nullptr;
+    int nTasks = 0;
+    int nBusyWorkers = 0;
+
+    std::atomic<int> nextTaskIdx{ 0 };
+    std::exception_ptr taskException;
+};
+
+inline ThreadPool::ThreadPool(int nThreads)
+{
+    assert(nThreads > 0);
+    workers.reserve(nThreads);
+
+    for (int iW = 0; iW < nThreads; ++iW)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this, iW);
+    }
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    startCondition.notify_all();
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+inline void ThreadPool::run(int nTasks, const Task &task)
+{
+    assert(nTasks >= 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    curTask = &task;
+    this->nTasks = nTasks;
+    nBusyWorkers = size();
+
+    nextTaskIdx = 0;
+    taskException = nullptr;
+    runIdx += 1;
+
+    startCondition.notify_all();
+    doneCondition.wait(lock, [this] { return nBusyWorkers == 0; });
+
+    curTask = nullptr;
+
+    if (taskException)
+    {
+        std::rethrow_exception(taskException);
+    }
+}
+
+inline void ThreadPool::workerLoop(int workerIdx)
+{
+    size_t lastRunIdx = 0;
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        startCondition.wait(lock, [this, lastRunIdx] { return stopping or runIdx != lastRunIdx; });
+
+        if (stopping)
+            return;
+
+        lastRunIdx = runIdx;
+
+        const Task &task = *curTask;
+        const int curNTasks = nTasks;
+
+        lock.unlock();
+
+        for (int taskIdx = nextTaskIdx++; taskIdx < curNTasks; taskIdx = nextTaskIdx++)
+        {
+            try
+            {
+                task(taskIdx, workerIdx);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> exceptionLock(mutex);
+
+                if (not taskException)
+                {
+                    taskException = std::current_exception();
+                }
+
+                // Remaining tasks are skipped.
+                nextTaskIdx = curNTasks;
+            }
+        }
+
+        lock.lock();
+        nBusyWorkers -= 1;
+
+        if (nBusyWorkers == 0)
+        {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+} // namespace sopang
+
+#endif // THREAD_POOL_HPP
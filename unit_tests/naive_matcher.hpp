@@ -0,0 +1,293 @@
+#ifndef NAIVE_MATCHER_HPP
+#define NAIVE_MATCHER_HPP
+
+#include "../ed_text.hpp"
+#include "../source_map.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace sopang
+{
+
+/** Straightforward reference matcher: tracks which pattern prefixes end at the current position (without bit-parallelism). */
+inline std::set<int> naiveMatch(const EdText &edText, const std::string &pattern)
+{
+    const size_t m = pattern.size();
+
+    std::set<int> res;
+    std::vector<bool> active(m + 1, false); // active[j] = the prefix of length j ends at the current position.
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        std::vector<bool> join(m + 1, false);
+
+        for (int iV = 0; iV < edText.segmentSize(iS); ++iV)
+        {
+            std::vector<bool> cur = active;
+
+            for (const char c : edText.variantStr(iS, iV))
+            {
+                std::vector<bool> next(m + 1, false);
+
+                for (size_t j = 0; j < m; ++j)
+                {
+                    next[j + 1] = ((j == 0 or cur[j]) and pattern[j] == c);
+                }
+
+                if (next[m])
+                {
+                    res.insert(iS);
+                }
+
+                cur = move(next);
+            }
+
+            for (size_t j = 0; j <= m; ++j)
+            {
+                join[j] = join[j] or cur[j];
+            }
+        }
+
+        active = move(join);
+    }
+
+    return res;
+}
+
+/** Reference approximate matcher: tracks the minimum number of mismatches (Hamming distance) for each pattern prefix ending at the current position. */
+inline std::set<int> naiveMatchApprox(const EdText &edText, const std::string &pattern, int k)
+{
+    const size_t m = pattern.size();
+    const int inf = std::numeric_limits<int>::max() / 2;
+
+    std::set<int> res;
+    std::vector<int> active(m + 1, inf); // active[j] = min mismatches for the prefix of length j ending at the current position.
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        std::vector<int> join(m + 1, inf);
+
+        for (int iV = 0; iV < edText.segmentSize(iS); ++iV)
+        {
+            std::vector<int> cur = active;
+
+            for (const char c : edText.variantStr(iS, iV))
+            {
+                std::vector<int> next(m + 1, inf);
+
+                for (size_t j = 0; j < m; ++j)
+                {
+                    next[j + 1] = (j == 0 ? 0 : cur[j]) + (pattern[j] == c ? 0 : 1);
+                }
+
+                if (next[m] <= k)
+                {
+                    res.insert(iS);
+                }
+
+                cur = move(next);
+            }
+
+            for (size_t j = 0; j <= m; ++j)
+            {
+                join[j] = std::min(join[j], cur[j]);
+            }
+        }
+
+        active = move(join);
+    }
+
+    return res;
+}
+
+/** Reference edit distance matcher: tracks the minimum edit distance for each pattern prefix aligned with a text suffix ending at the current position. */
+inline std::set<int> naiveMatchEdit(const EdText &edText, const std::string &pattern, int k)
+{
+    const size_t m = pattern.size();
+
+    std::set<int> res;
+    std::vector<int> active(m + 1); // active[j] = min edit distance for the prefix of length j.
+
+    for (size_t j = 0; j <= m; ++j)
+    {
+        active[j] = static_cast<int>(j); // The prefix is deleted.
+    }
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        std::vector<int> join(m + 1, std::numeric_limits<int>::max());
+
+        for (int iV = 0; iV < edText.segmentSize(iS); ++iV)
+        {
+            std::vector<int> cur = active;
+
+            for (const char c : edText.variantStr(iS, iV))
+            {
+                std::vector<int> next(m + 1, 0);
+
+                for (size_t j = 1; j <= m; ++j)
+                {
+                    next[j] = std::min({ cur[j - 1] + (pattern[j - 1] == c ? 0 : 1), cur[j] + 1, next[j - 1] + 1 });
+                }
+
+                if (next[m] <= k)
+                {
+                    res.insert(iS);
+                }
+
+                cur = move(next);
+            }
+
+            for (size_t j = 0; j <= m; ++j)
+            {
+                join[j] = std::min(join[j], cur[j]);
+            }
+        }
+
+        active = move(join);
+    }
+
+    return res;
+}
+
+/** Reference matcher with sources: each source is spelled out as a plain string and searched separately with up to [k] mismatches.
+ * Returns segment index -> sources for which a match ends in that segment. */
+inline std::map<int, std::set<int>> naiveMatchSources(const EdText &edText,
+    const SourceMap &sourceMap,
+    int sourceCount,
+    const std::string &pattern,
+    int k = 0)
+{
+    std::map<int, std::set<int>> res;
+
+    for (int iSource = 0; iSource < sourceCount; ++iSource)
+    {
+        std::string text;
+        std::vector<int> charSegments; // Segment index for each character of text.
+
+        for (int iS = 0; iS < edText.nSegments(); ++iS)
+        {
+            int variantIdx = 0;
+
+            if (sourceMap.hasSources(iS))
+            {
+                while (not sourceMap.sources(iS, variantIdx).test(iSource))
+                {
+                    variantIdx += 1;
+                }
+            }
+
+            const std::string variant = edText.variantStr(iS, variantIdx);
+
+            text += variant;
+            charSegments.insert(charSegments.end(), variant.size(), iS);
+        }
+
+        for (size_t end = pattern.size(); end <= text.size(); ++end)
+        {
+            int nErrors = 0;
+
+            for (size_t i = 0; i < pattern.size(); ++i)
+            {
+                nErrors += (pattern[i] != text[end - pattern.size() + i]) ? 1 : 0;
+            }
+
+            if (nErrors <= k)
+            {
+                res[charSegments[end - 1]].insert(iSource);
+            }
+        }
+    }
+
+    return res;
+}
+
+/** Assigns each of [sourceCount] sources to a random variant in each non-deterministic segment of [edText]. */
+inline SourceMap genRandomSourceMap(const EdText &edText, int sourceCount)
+{
+    std::random_device rd;
+    std::mt19937 mt(rd());
+
+    std::vector<std::vector<SourceSet>> sources;
+    std::vector<int> segmentSizes(edText.nSegments());
+
+    for (int iS = 0; iS < edText.nSegments(); ++iS)
+    {
+        segmentSizes[iS] = edText.segmentSize(iS);
+
+        if (edText.segmentSize(iS) == 1)
+            continue;
+
+        std::vector<SourceSet> variantSources(edText.segmentSize(iS), SourceSet(sourceCount));
+
+        for (int iSource = 0; iSource < sourceCount; ++iSource)
+        {
+            variantSources[mt() % edText.segmentSize(iS)].set(iSource);
+        }
+
+        sources.push_back(std::move(variantSources));
+    }
+
+    return SourceMap(edText.nSegments(), segmentSizes.data(), std::move(sources));
+}
+
+/** Returns a random ED text having [nSegments] segments over [alphabet], non-deterministic segments have up to [maxVariants] variants. */
+inline std::string genRandomEdText(int nSegments, const std::string &alphabet, int maxVariants = 4, int maxVariantSize = 5)
+{
+    std::random_device rd;
+    std::mt19937 mt(rd());
+
+    std::uniform_int_distribution<int> charDist(0, alphabet.size() - 1);
+    std::uniform_int_distribution<int> variantCountDist(2, maxVariants);
+    std::uniform_int_distribution<int> variantSizeDist(0, maxVariantSize);
+
+    std::string res;
+    bool prevDeterministic = false;
+
+    for (int iS = 0; iS < nSegments; ++iS)
+    {
+        // Deterministic segments cannot be adjacent, otherwise they would be parsed as a single segment.
+        const bool deterministic = (not prevDeterministic and mt() % 2 == 0);
+
+        if (deterministic)
+        {
+            const int size = 1 + variantSizeDist(mt);
+
+            for (int i = 0; i < size; ++i)
+            {
+                res += alphabet[charDist(mt)];
+            }
+        }
+        else
+        {
+            const int nVariants = variantCountDist(mt);
+            res += "{";
+
+            for (int iV = 0; iV < nVariants; ++iV)
+            {
+                const int size = variantSizeDist(mt);
+
+                for (int i = 0; i < size; ++i)
+                {
+                    res += alphabet[charDist(mt)];
+                }
+
+                res += (iV == nVariants - 1) ? "}" : ",";
+            }
+        }
+
+        prevDeterministic = deterministic;
+    }
+
+    return res;
+}
+
+} // namespace sopang
+
+#endif // NAIVE_MATCHER_HPP
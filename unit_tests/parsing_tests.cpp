@@ -4,8 +4,11 @@
 #include "../parsing.hpp"
 #include "../sopang.hpp"
 
+#include <cstring>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 using namespace std;
@@ -182,6 +185,141 @@ TEST_CASE("is parsing text with spaces correct", "[parsing]")
     REQUIRE(segments[1][2] == "C C C");
 }
 
+TEST_CASE("is parsing flat text for an empty string correct", "[parsing]")
+{
+    const EdText edText = parsing::parseEdText("");
+
+    REQUIRE(edText.nSegments() == 0);
+    REQUIRE(edText.size() == 0);
+    REQUIRE(edText.maxSegmentSize() == 0);
+}
+
+TEST_CASE("is parsing flat text for determinate and indeterminate segments correct", "[parsing]")
+{
+    const EdText edText = parsing::parseEdText("AAA{A,C,G,GGT}AAA{A,C}{A,C}ACG");
+
+    REQUIRE(edText.nSegments() == 6);
+    REQUIRE(edText.size() == 19);
+
+    REQUIRE(edText.segmentSize(0) == 1);
+    REQUIRE(edText.segmentSize(1) == 4);
+    REQUIRE(edText.segmentSize(2) == 1);
+    REQUIRE(edText.segmentSize(3) == 2);
+    REQUIRE(edText.segmentSize(4) == 2);
+    REQUIRE(edText.segmentSize(5) == 1);
+    REQUIRE(edText.maxSegmentSize() == 4);
+
+    REQUIRE(edText.variantStr(0, 0) == "AAA");
+    REQUIRE(edText.variantStr(1, 0) == "A");
+    REQUIRE(edText.variantStr(1, 1) == "C");
+    REQUIRE(edText.variantStr(1, 2) == "G");
+    REQUIRE(edText.variantStr(1, 3) == "GGT");
+    REQUIRE(edText.variantStr(2, 0) == "AAA");
+    REQUIRE(edText.variantStr(3, 0) == "A");
+    REQUIRE(edText.variantStr(3, 1) == "C");
+    REQUIRE(edText.variantStr(4, 0) == "A");
+    REQUIRE(edText.variantStr(4, 1) == "C");
+    REQUIRE(edText.variantStr(5, 0) == "ACG");
+
+    // Variants are stored back to back in a single arena.
+    REQUIRE(edText.variantBegin(1, 3) + 3 == edText.variantBegin(2, 0));
+    REQUIRE(edText.variantBegin(5, 0)[3] == '\0');
+}
+
+TEST_CASE("is parsing flat text for indeterminate segments with empty words correct", "[parsing]")
+{
+    const EdText edText = parsing::parseEdText("{A,C,}{A,,C}{,A,C}");
+
+    REQUIRE(edText.nSegments() == 3);
+
+    for (int iS = 0; iS < 3; ++iS)
+    {
+        REQUIRE(edText.segmentSize(iS) == 3);
+    }
+
+    REQUIRE(edText.variantSize(0, 2) == 0);
+    REQUIRE(edText.variantSize(1, 1) == 0);
+    REQUIRE(edText.variantSize(2, 0) == 0);
+
+    REQUIRE(edText.variantStr(0, 1) == "C");
+    REQUIRE(edText.variantStr(1, 2) == "C");
+    REQUIRE(edText.variantStr(2, 1) == "A");
+}
+
+TEST_CASE("is parsing flat text equivalent to parsing text array", "[parsing]")
+{
+    for (const string &text : { "ACGT", "{A,C}AAA{A,C,G,GGT}AAA{A,C}", "{AC,CG}{A,,CCC}", "ACGT{,AA,CC,GG}{AA,,CC,GG}{AA,CC,,GG}{AA,CC,GG,}ACGT" })
+    {
+        int nSegments;
+        int *segmentSizes;
+
+        const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
+        const EdText edText = parsing::parseEdText(text);
+        const EdText edTextFromArray(segments, nSegments, segmentSizes);
+
+        REQUIRE(edText.nSegments() == nSegments);
+        REQUIRE(edTextFromArray.nSegments() == nSegments);
+
+        for (int iS = 0; iS < nSegments; ++iS)
+        {
+            REQUIRE(edText.segmentSize(iS) == segmentSizes[iS]);
+            REQUIRE(edTextFromArray.segmentSize(iS) == segmentSizes[iS]);
+
+            for (int iV = 0; iV < segmentSizes[iS]; ++iV)
+            {
+                REQUIRE(edText.variantStr(iS, iV) == segments[iS][iV]);
+                REQUIRE(edTextFromArray.variantStr(iS, iV) == segments[iS][iV]);
+            }
+        }
+    }
+}
+
+TEST_CASE("does parsing flat text throw for bad strings", "[parsing]")
+{
+    REQUIRE_THROWS_AS(parsing::parseEdText("AC,GT"), runtime_error);
+}
+
+TEST_CASE("does parsing flat text throw for symbols outside the alphabet", "[parsing]")
+{
+    for (const string &text : { "ACGTB", "{A,C}AAA{A,B}", "{AC, CG}", "acgt" })
+    {
+        REQUIRE_THROWS_AS(parsing::parseEdText<DnaAlphabet>(text), runtime_error);
+    }
+
+    const EdText edText = parsing::parseEdText<ProteinAlphabet>("ACBD{A,CW,}YZ");
+
+    REQUIRE(edText.nSegments() == 3);
+    REQUIRE(edText.variantStr(0, 0) == "ACBD");
+    REQUIRE(edText.variantStr(1, 1) == "CW");
+    REQUIRE(edText.variantStr(2, 0) == "YZ");
+}
+
+TEST_CASE("does validating patterns throw for symbols outside the alphabet", "[parsing]")
+{
+    REQUIRE_NOTHROW(parsing::validatePatterns<DnaAlphabet>({ "ACGTN", "A" }));
+    REQUIRE_THROWS_AS(parsing::validatePatterns<DnaAlphabet>({ "ACGT", "ACXT" }), runtime_error);
+    REQUIRE_NOTHROW(parsing::validatePatterns<ProteinAlphabet>({ "MKVLA" }));
+}
+
+TEST_CASE("are alphabet codes unique and dense", "[parsing]")
+{
+    for (const char *symbols : { DnaAlphabet::symbols, ProteinAlphabet::symbols })
+    {
+        const bool isDna = (symbols == DnaAlphabet::symbols);
+        unordered_set<unsigned> codes;
+
+        for (const char *c = symbols; *c != '\0'; ++c)
+        {
+            const unsigned code = isDna ? DnaAlphabet::code(*c) : ProteinAlphabet::code(*c);
+            REQUIRE(code < (isDna ? DnaAlphabet::codeCount : ProteinAlphabet::codeCount));
+
+            codes.insert(code);
+        }
+
+        REQUIRE(codes.size() == strlen(symbols));
+    }
+}
+
 TEST_CASE("is parsing patterns for an empty string correct", "[parsing]")
 {
     vector<string> empty = parsing::parsePatterns("");
@@ -403,18 +541,75 @@ TEST_CASE("is parsing compressed sources for multiple segments correct", "[parsi
     REQUIRE(sources[2][1] == Sopang::SourceSet{ 0 });
 }
 
+TEST_CASE("is parsing compressed sources with multi-byte source indexes correct", "[parsing]")
+{
+    string sourcesStr = "70000\n";
+    sourcesStr += static_cast<unsigned char>(127); // segment start
+    sourcesStr += static_cast<unsigned char>(130); // len = 2 (+128)
+    sourcesStr += static_cast<unsigned char>(1);   // 20000 = 1 * 128^2
+    sourcesStr += static_cast<unsigned char>(28);  //   + 28 * 128
+    sourcesStr += static_cast<unsigned char>(160); //   + 32 (+128)
+    sourcesStr += static_cast<unsigned char>(0);   // leading zero digit (skipped)
+    sourcesStr += static_cast<unsigned char>(3);   // diff = 49999 = 3 * 128^2
+    sourcesStr += static_cast<unsigned char>(6);   //   + 6 * 128
+    sourcesStr += static_cast<unsigned char>(207); //   + 79 (+128)
+
+    int sourceCount;
+    const auto sources = parsing::parseSourcesCompressed(sourcesStr, sourceCount);
+
+    REQUIRE(sourceCount == 70'000);
+    REQUIRE(sources.size() == 1);
+    REQUIRE(sources[0].size() == 2);
+
+    REQUIRE(sources[0][0].toSet() == set<int>{ 20'000, 69'999 });
+    REQUIRE(sources[0][1].count() == 70'000 - 2);
+    REQUIRE(not sources[0][1].test(69'999));
+    REQUIRE(sources[0][1].test(69'998));
+}
+
+TEST_CASE("is parsing compressed sources with bad numbers throwing", "[parsing]")
+{
+    int sourceCount;
+
+    string sourcesStr = "8\n";
+    sourcesStr += static_cast<unsigned char>(127); // segment start
+    sourcesStr += static_cast<unsigned char>(129); // len = 1 (+128)
+    sourcesStr += static_cast<unsigned char>(136); // 8 (+128), out of range
+
+    REQUIRE_THROWS_AS(parsing::parseSourcesCompressed(sourcesStr, sourceCount), runtime_error);
+
+    sourcesStr = "8\n";
+    sourcesStr += static_cast<unsigned char>(127); // segment start
+    sourcesStr += static_cast<unsigned char>(130); // len = 2 (+128)
+    sourcesStr += static_cast<unsigned char>(1);   // not terminated
+
+    REQUIRE_THROWS_AS(parsing::parseSourcesCompressed(sourcesStr, sourceCount), runtime_error);
+}
+
 TEST_CASE("is converting sources to source map correct", "[parsing]")
 {
     vector<vector<Sopang::SourceSet>> sources { { { 1, 2 }, { 3, 4 } }, { { 1 }, { 2, 3 }, { 4 } }, { { 3, 4 }, { 1, 2 } } };
     vector<int> segmentSizes { 1, 2, 3, 2, 1 };
 
-    Sopang::SourceMap sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+    const Sopang::SourceMap sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
 
-    REQUIRE(sourceMap.size() == 3);
+    REQUIRE(sourceMap.nSegments() == 3);
 
-    REQUIRE(sourceMap[1].size() == 2);
-    REQUIRE(sourceMap[2].size() == 3);
-    REQUIRE(sourceMap[3].size() == 2);
+    REQUIRE(not sourceMap.hasSources(0));
+    REQUIRE(not sourceMap.hasSources(4));
+    REQUIRE(sourceMap.segmentSize(0) == 0);
+
+    REQUIRE(sourceMap.segmentSize(1) == 2);
+    REQUIRE(sourceMap.segmentSize(2) == 3);
+    REQUIRE(sourceMap.segmentSize(3) == 2);
+
+    for (int iS = 1; iS <= 3; ++iS)
+    {
+        for (int iV = 0; iV < segmentSizes[iS]; ++iV)
+        {
+            REQUIRE(sourceMap.sources(iS, iV) == sources[iS - 1][iV]);
+        }
+    }
 }
 
 } // namespace sopang
@@ -1,4 +1,5 @@
 #include "catch.hpp"
+#include "naive_matcher.hpp"
 #include "repeat.hpp"
 #include "sopang_whitebox.hpp"
 
@@ -6,7 +7,12 @@
 #include "../parsing.hpp"
 #include "../sopang.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -33,7 +39,7 @@ TEST_CASE("is approx matching for a single segment exact correct for whole segme
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (int k : { 1, 2, 3, 4 })
     {
@@ -50,7 +56,7 @@ TEST_CASE("is approx matching for a single segment exact correct for partial seg
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACG", "CGT" })
     {
@@ -70,7 +76,7 @@ TEST_CASE("is approx matching for a single segment correct for 1 error for whole
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NCGT", "ANGT", "ACNT", "ACGN" })
     {
@@ -90,7 +96,7 @@ TEST_CASE("is approx matching for a single segment correct for 1 error for parti
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACN", "ANG", "NCG", "NGT", "CNT", "CGN" })
     {
@@ -110,7 +116,7 @@ TEST_CASE("is approx matching for a single longer segment correct for 1 error fo
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGTAAGGCTTTAAGCTTA", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ANGCT", "AGNCT", "AGGNT", "AGGCN" })
     {
@@ -127,7 +133,7 @@ TEST_CASE("is approx matching for a single longer segment at 2nd position correc
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("{ACC,AAAC}ACGTAAGGCTTTAAGCTTA{CC,AA}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ANGCT", "AGNCT", "AGGNT", "AGGCN" })
     {
@@ -144,7 +150,7 @@ TEST_CASE("is approx matching for a single segment correct for 2 errors for part
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NNG", "ANN", "NCN", "NNT", "NGN", "CNN" })
     {
@@ -167,7 +173,7 @@ TEST_CASE("is approx matching multiple determinate segments exact correct for pa
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACG", "CGT" })
     {
@@ -187,7 +193,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for 1 error
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NCGT", "ANGT", "ACNT", "ACGN" })
     {
@@ -207,7 +213,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for 1 error
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACN", "ANG", "NCG", "NGT", "CNT", "CGN" })
     {
@@ -227,7 +233,7 @@ TEST_CASE("is approx matching for a single segment correct for 2 errors for whol
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NNGT", "ANNT", "ACNN" })
     {
@@ -250,7 +256,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for 2 errors
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NNGT", "ANNT", "ACNN" })
     {
@@ -273,7 +279,7 @@ TEST_CASE("is approx matching multiple short contiguous indeterminate segments c
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AC{A,G,C}T{,A}{A,T}{C,GC}{A,CA,T}{CA,GG}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.matchApprox(segments, nSegments, segmentSizes, "CTATGCTC", 1);
    
@@ -287,7 +293,7 @@ TEST_CASE("is approx matching multiple short contiguous indeterminate segments c
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AC{A,G,C}T{,A}{A,T}{C,GC}{A,CA,T}{CA,GG}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     string basePattern = "CTATGCTC";
 
@@ -309,7 +315,7 @@ TEST_CASE("is approx matching multiple short contiguous indeterminate segments c
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AC{A,G,C}T{,A}{A,T}{C,GC}{A,CA,T}{CA,GG}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
     string basePattern = "ACCTATGCTCA";
 
     repeat(nRandIter, [&] {
@@ -334,7 +340,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for 2 errors
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGTT{A,C}ACGTT{,A}ACGTT{AAAAA,GGGG}ACGTT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "NNGT", "ANNT", "NCNT", "NNTT", "NGNT", "CNNT" })
     {
@@ -357,7 +363,7 @@ TEST_CASE("is approx matching multiple indeterminate and determinate segments wi
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,AA,CC,GG}{AA,,CC,GG}{AA,CC,,GG}{AA,CC,GG,}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     // Only letters from the first and the last segment.
     unordered_set<int> res = sopang.matchApprox(segments, nSegments, segmentSizes, "ACGTACGT", 1);
@@ -390,7 +396,7 @@ TEST_CASE("is approx matching multiple indeterminate and determinate segments wi
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,AA,CC,GG}{AA,,CC,GG}{AA,CC,,GG}{AA,CC,GG,}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     // Only letters from the first and the last segment.
     string basePattern1 = "ACGTACGT";
@@ -453,7 +459,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for whole se
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.matchApprox(segments, nSegments, segmentSizes, det, 1);
     REQUIRE(res.size() == 2);
@@ -478,7 +484,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for partial
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "AACTN", "NAACT" })
     {
@@ -506,7 +512,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for whole se
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
     
     for (size_t i = 0; i < det.size(); ++i)
     {
@@ -539,7 +545,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for whole se
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.matchApprox(segments, nSegments, segmentSizes, det, 1);
     REQUIRE(res.size() == nTextRepeats);
@@ -568,7 +574,7 @@ TEST_CASE("is approx matching multiple determinate segments correct for whole se
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (size_t i = 0; i < det.size(); ++i)
     {
@@ -591,7 +597,7 @@ TEST_CASE("is approx matching single indeterminate and determinate segments for
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "TAAC", "TCAC" })
     {
@@ -608,7 +614,7 @@ TEST_CASE("is approx matching single indeterminate and determinate segments for
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C,G,T}{AAA,CCC,GGG,TTT}{ACGT,TGCA}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "TAAAAAC", "TAAAATG", "TCCCCAC", "TCCCCTG", "TGGGGAC", "TGGGGTG", "TTTTTAC", "TTTTTTG" })
     {
@@ -625,7 +631,7 @@ TEST_CASE("is approx matching single indeterminate and determinate segments for
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C,G,T}{AAA,CCC,GGG,TTT}{ACGT,TGCA}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &basePattern : { "TAAAAAC", "TAAAATG", "TCCCCAC", "TCCCCTG", "TGGGGAC", "TGGGGTG", "TTTTTAC", "TTTTTTG" })
     {
@@ -648,7 +654,7 @@ TEST_CASE("is approx matching single indeterminate and determinate segments for
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "TAAN", "TANC", "TNAC", "NAAC", "TCAN", "TCNC", "NCAC" })
     {
@@ -665,7 +671,7 @@ TEST_CASE("is approx matching for contiguous indeterminate segments correct for
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}{,AA}{,AAAAA,TTTT}{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res1 = sopang.matchApprox(segments, nSegments, segmentSizes, "CGTCAANA", 1);
     
@@ -689,7 +695,7 @@ TEST_CASE("is approx matching multiple indeterminate and determinate segments wi
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("{AA,CCAA}ACGT{AAA,CCC,TTT}{,AA}{A,C,}{AAA,CCC,T}TTCC{AA,CC}AAA", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res1 = sopang.matchApprox(segments, nSegments, segmentSizes, "ACGTAAN", 1);
     
@@ -721,7 +727,7 @@ TEST_CASE("is approx matching multiple indeterminate and determinate segments wi
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AACABBCBBC{A,AAB,ACCA}BB{C,ACABBCBB,CBA}BACABBC{B,CABB,BBC,AACABB,CBC}", &nSegments, &segmentSizes);
 
-    Sopang sopang("ABCN");
+    BasicSopang<ProteinAlphabet> sopang;
 
     unordered_set<int> res = sopang.matchApprox(segments, nSegments, segmentSizes, "CABNCB", 1);
     REQUIRE(res.size() == 4);
@@ -738,7 +744,7 @@ TEST_CASE("is approx matching pattern starting and ending with text correct", "[
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("{A,C}ACGT{G,C}ACGT{,T}ACGT{GGGG,TTTT,C}AAC{A,G}TGA", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     string basePattern = "AACGTGA";
 
@@ -762,7 +768,7 @@ TEST_CASE("is approx matching pattern length 8 correct for 1 error", "[approx]")
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     string basePattern = "ACGTACGT";
 
@@ -787,7 +793,7 @@ TEST_CASE("is approx matching pattern length 8 correct for 2 errors", "[approx]"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
     string basePattern = "ACGTACGT";
 
     repeat(nRandIter, [&] {
@@ -815,7 +821,7 @@ TEST_CASE("is approx matching pattern length 10 correct for 1 error", "[approx]"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,GGGG,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     string basePattern = "ACGTACGTAC";
 
@@ -838,7 +844,7 @@ TEST_CASE("is approx matching pattern length 12 correct for 1 error", "[approx]"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,GGGG,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     string basePattern = "ACGTACGTACGT";
 
@@ -854,11 +860,291 @@ TEST_CASE("is approx matching pattern length 12 correct for 1 error", "[approx]"
     }
 }
 
+TEST_CASE("is approx matching with a sorted vector sink equivalent to returning a set", "[approx]")
+{
+    const EdText edText = parsing::parseEdText("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT");
+    Sopang sopang;
+
+    for (const string &pattern : { "ACGT", "TTTTA", "GGTA", "CAC" })
+    {
+        const unordered_set<int> expected = sopang.matchApprox(edText, pattern, 1);
+
+        SortedVectorSink sink;
+        sopang.matchApprox(edText, pattern, 1, sink);
+
+        REQUIRE(is_sorted(sink.indexes.begin(), sink.indexes.end()));
+        REQUIRE(unordered_set<int>(sink.indexes.begin(), sink.indexes.end()) == expected);
+        REQUIRE(sink.indexes.size() == expected.size());
+    }
+}
+
+TEST_CASE("is approx matching correct for a segment with more variants than the previous fixed buffer size", "[approx]")
+{
+    const int nVariants = 300'000;
+    string text = "ACGT{";
+
+    for (int i = 0; i < nVariants - 1; ++i)
+    {
+        text += "A,";
+    }
+
+    text += "CCCC}ACGT";
+
+    // The same instance is used for a narrow text first, so that the scratch buffer has to grow.
+    Sopang sopang;
+    REQUIRE(sopang.matchApprox(parsing::parseEdText("ACGT{A,C}ACGT"), "GTCA", 1).count(2) == 1);
+
+    const EdText edText = parsing::parseEdText(text);
+    REQUIRE(edText.maxSegmentSize() == nVariants);
+
+    const unordered_set<int> res = sopang.matchApprox(edText, "TCCCC", 1);
+
+    REQUIRE(res.count(0) == 0);
+    REQUIRE(res.count(1) == 1);
+}
+
+TEST_CASE("is approx matching correct for random texts", "[approx]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(300, "ACG", 3, 8));
+
+        for (int size : { 1, 5, 12 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+
+            for (int k : { 1, 2, 5 })
+            {
+                const unordered_set<int> res = sopang.matchApprox(edText, pattern, k);
+                REQUIRE(set<int>(res.begin(), res.end()) == naiveMatchApprox(edText, pattern, k));
+            }
+        }
+    });
+}
+
+TEST_CASE("is approx matching long patterns with multi-word counters correct for random texts", "[approx]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(500, "AC", 3, 12));
+
+        for (int size : { 13, 16, 17, 40, 64, 100, 128 })
+        {
+            // Patterns consisting mostly of a single character in order to obtain some matches.
+            string pattern(size, 'A');
+
+            for (int i = 0; i < size / 10 + 1; ++i)
+            {
+                pattern[helpers::randIntRangeExcluded(0, size - 1, -1)] = 'C';
+            }
+
+            for (int k : { 1, 3, 10, 20 })
+            {
+                const unordered_set<int> res = sopang.matchApprox(edText, pattern, k);
+                REQUIRE(set<int>(res.begin(), res.end()) == naiveMatchApprox(edText, pattern, k));
+            }
+        }
+    });
+}
+
+TEST_CASE("is approx matching short patterns correct for k exceeding single-word counters", "[approx]")
+{
+    Sopang sopang;
+    const EdText edText = parsing::parseEdText(genRandomEdText(200, "ACGT", 3, 6));
+
+    for (int size : { 4, 12, 20 })
+    {
+        const string pattern = helpers::genRandomString(size, "ACGT");
+
+        for (int k : { 15, 16, 30 })
+        {
+            const unordered_set<int> res = sopang.matchApprox(edText, pattern, k);
+            REQUIRE(set<int>(res.begin(), res.end()) == naiveMatchApprox(edText, pattern, k));
+        }
+    }
+}
+
+TEST_CASE("is approx minimum distance correct for a predefined text", "[approx]")
+{
+    const EdText edText = parsing::parseEdText("ACGT{A,C}GT{T,,G}AC");
+    Sopang sopang;
+
+    // Exact in segment 0, "TCGT" and "AGTT" are the closest in segments 2 and 3, segments 1 and 4 require more than 2 mismatches.
+    const unordered_map<int, int> res = sopang.matchApproxMinDistance(edText, "ACGT", 2);
+
+    REQUIRE(res == unordered_map<int, int>{ { 0, 0 }, { 2, 1 }, { 3, 2 } });
+    REQUIRE(sopang.matchApproxMinDistance(edText, "ACGT", 3).at(4) == 3);
+}
+
+TEST_CASE("is approx minimum distance consistent with approx matching for all k", "[approx]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(300, "ACG", 4, 6));
+
+        for (int size : { 1, 5, 12, 16, 40, 128 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+
+            for (int kMax : { 1, 3, 15, 20 })
+            {
+                const unordered_map<int, int> res = sopang.matchApproxMinDistance(edText, pattern, kMax);
+
+                for (const auto &kv : res)
+                {
+                    REQUIRE(kv.second >= 0);
+                    REQUIRE(kv.second <= kMax);
+                }
+
+                for (int k = 1; k <= kMax; k += (kMax + 3) / 4)
+                {
+                    set<int> expected;
+
+                    for (const auto &kv : res)
+                    {
+                        if (kv.second <= k)
+                        {
+                            expected.insert(kv.first);
+                        }
+                    }
+
+                    REQUIRE(expected == naiveMatchApprox(edText, pattern, k));
+                }
+            }
+        }
+    });
+}
+
+TEST_CASE("is filtered approx matching correct for a piece spanning segments", "[approx]")
+{
+    const EdText edText = parsing::parseEdText("ACGTACGT{A,C}CGTACGTA{,GG}CCCCCCCC");
+    Sopang sopang;
+
+    // Piece "ACGTACGT" is exact, the mismatch falls into the second piece.
+    REQUIRE(sopang.matchApproxFiltered(edText, "ACGTACGTACGTTCGT", 1) == unordered_set<int>{ 2 });
+    // Second piece "CGTACGTA" is exact, the first one crosses the variant segment with a mismatch.
+    REQUIRE(sopang.matchApproxFiltered(edText, "CGTTCGTCCGTACGTA", 1) == unordered_set<int>{ 2 });
+    // First piece "CGTACGTA" is exact, the second one follows the empty variant.
+    REQUIRE(sopang.matchApproxFiltered(edText, "CGTACGTACCCTCCCC", 1) == unordered_set<int>{ 4 });
+    REQUIRE(sopang.matchApproxFiltered(edText, "GGGGGGGGGGGGGGGG", 1).empty());
+}
+
+TEST_CASE("is filtered approx matching correct for random texts", "[approx]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        // Variants of size 0 make the windows extend over several segments.
+        const EdText edText = parsing::parseEdText(genRandomEdText(500, "AC", 4, 6));
+
+        for (int size : { 8, 16, 17, 40, 64, 128 })
+        {
+            string pattern(size, 'A');
+
+            for (int i = 0; i < size / 10 + 1; ++i)
+            {
+                pattern[helpers::randIntRangeExcluded(0, size - 1, -1)] = 'C';
+            }
+
+            for (int k : { 1, 2, 3, 7 })
+            {
+                const unordered_set<int> res = sopang.matchApproxFiltered(edText, pattern, k);
+                REQUIRE(res == sopang.matchApprox(edText, pattern, k));
+                REQUIRE(set<int>(res.begin(), res.end()) == naiveMatchApprox(edText, pattern, k));
+
+                FirstNSink firstSink(2);
+                sopang.matchApproxFiltered(edText, pattern, k, firstSink);
+
+                const set<int> resSorted(res.begin(), res.end());
+                REQUIRE(firstSink.indexes == vector<int>(resSorted.begin(), next(resSorted.begin(), min<size_t>(2, resSorted.size()))));
+            }
+        }
+    });
+}
+
+TEST_CASE("is edit distance matching correct for indels and empty variants", "[approx]")
+{
+    const EdText edText = parsing::parseEdText("AC{G,,T}TA{A,C}");
+    Sopang sopang;
+
+    // Exact through the empty variant ending in segment 2, "ACT" (a deletion) and "ACTAA" (an insertion).
+    REQUIRE(sopang.matchEdit(edText, "ACTA", 1) == unordered_set<int>{ 1, 2, 3 });
+    // A single deletion from "ACGTA", not a match under the Hamming distance.
+    REQUIRE(sopang.matchEdit(edText, "ACGGTA", 1) == unordered_set<int>{ 2 });
+    REQUIRE(sopang.matchApprox(edText, "ACGGTA", 1).empty());
+    // A single substitution in "CGTAC".
+    REQUIRE(sopang.matchEdit(edText, "AGTAC", 1) == unordered_set<int>{ 3 });
+    REQUIRE(sopang.matchEdit(edText, "GGGGG", 1).empty());
+}
+
+TEST_CASE("is edit distance matching correct for random texts", "[approx]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        // Variants of size 0 make empty variants frequent.
+        const EdText edText = parsing::parseEdText(genRandomEdText(200, "ACG", 4, 4));
+
+        for (int size : { 1, 4, 9, 20, 64 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+
+            for (int k : { 1, 2, 4, 16 })
+            {
+                const unordered_set<int> res = sopang.matchEdit(edText, pattern, k);
+                REQUIRE(set<int>(res.begin(), res.end()) == naiveMatchEdit(edText, pattern, k));
+
+                FirstNSink firstSink(2);
+                sopang.matchEdit(edText, pattern, k, firstSink);
+
+                const set<int> resSorted(res.begin(), res.end());
+                REQUIRE(firstSink.indexes == vector<int>(resSorted.begin(), next(resSorted.begin(), min<size_t>(2, resSorted.size()))));
+            }
+        }
+    });
+}
+
+TEST_CASE("is counter-wise minimum correct for random words", "[approx]")
+{
+    mt19937_64 mt(42);
+
+    const auto checkMin = [&mt](auto minCounters, size_t counterSize) {
+        const uint64_t counterAllSet = (0x1ULL << counterSize) - 1;
+
+        for (int i = 0; i < 10'000; ++i)
+        {
+            uint64_t x = mt(), y = mt();
+
+            // Equal counters are made more likely.
+            if (i % 4 == 0)
+            {
+                y = (x & mt()) | (y & mt());
+            }
+
+            const uint64_t res = minCounters(x, y);
+
+            for (size_t iC = 0; iC < 64 / counterSize; ++iC)
+            {
+                const uint64_t xC = (x >> (iC * counterSize)) & counterAllSet;
+                const uint64_t yC = (y >> (iC * counterSize)) & counterAllSet;
+
+                REQUIRE(((res >> (iC * counterSize)) & counterAllSet) == min(xC, yC));
+            }
+        }
+    };
+
+    checkMin(SopangWhitebox::minCounters<5>, 5);
+    checkMin(SopangWhitebox::minCounters<8>, 8);
+}
+
 TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[approx]")
 {
     const string pattern = "ACAACGT";
     
-    Sopang sopang(alphabet);
+    Sopang sopang;
     SopangWhitebox::fillPatternMaskBufferApprox(sopang, "ACAACGT");
 
     const size_t saCounterSize = SopangWhitebox::getSACounterSize(sopang);
@@ -867,7 +1153,7 @@ TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[ap
     const size_t saBitShiftRight = wordSize - saCounterSize;
     const uint64_t *maskBuffer = SopangWhitebox::getMaskBuffer(sopang);
     
-    uint64_t maskA = maskBuffer[static_cast<size_t>('A')];
+    uint64_t maskA = maskBuffer[DnaAlphabet::code('A')];
     const vector<uint64_t> expectedA { 0x0, 0x1, 0x0, 0x0, 0x1, 0x1, 0x1 };
 
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -875,7 +1161,7 @@ TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[ap
         REQUIRE(((maskA << (saBitShiftRight - i * saCounterSize)) >> saBitShiftRight) == expectedA[i]);
     }
 
-    uint64_t maskC = maskBuffer[static_cast<size_t>('C')];
+    uint64_t maskC = maskBuffer[DnaAlphabet::code('C')];
     const vector<uint64_t> expectedC { 0x1, 0x0, 0x1, 0x1, 0x0, 0x1, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -883,7 +1169,7 @@ TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[ap
         REQUIRE(((maskC << (saBitShiftRight - i * saCounterSize)) >> saBitShiftRight) == expectedC[i]);
     }
 
-    uint64_t maskG = maskBuffer[static_cast<size_t>('G')];
+    uint64_t maskG = maskBuffer[DnaAlphabet::code('G')];
     const vector<uint64_t> expectedG { 0x1, 0x1, 0x1, 0x1, 0x1, 0x0, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -891,7 +1177,7 @@ TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[ap
         REQUIRE(((maskG << (saBitShiftRight - i * saCounterSize)) >> saBitShiftRight) == expectedG[i]);
     }
 
-    uint64_t maskT = maskBuffer[static_cast<size_t>('T')];
+    uint64_t maskT = maskBuffer[DnaAlphabet::code('T')];
     const vector<uint64_t> expectedT { 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x0 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -899,7 +1185,7 @@ TEST_CASE("is filling approx mask buffer correct for a predefined pattern", "[ap
         REQUIRE(((maskT << (saBitShiftRight - i * saCounterSize)) >> saBitShiftRight) == expectedT[i]);
     }
 
-    uint64_t maskN = maskBuffer[static_cast<size_t>('N')];
+    uint64_t maskN = maskBuffer[DnaAlphabet::code('N')];
     const vector<uint64_t> expectedN { 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -917,7 +1203,7 @@ TEST_CASE("is filling approx mask buffer correct for repeated same character in
             string pattern = "";
             repeat(size, [c, &pattern] { pattern += c; });
 
-            Sopang sopang(alphabet);
+            Sopang sopang;
 
             const size_t saCounterSize = SopangWhitebox::getSACounterSize(sopang);
             const size_t wordSize = SopangWhitebox::getWordSize(sopang);
@@ -933,11 +1219,11 @@ TEST_CASE("is filling approx mask buffer correct for repeated same character in
                 {
                     if (curC == c) // Corresponding occurrences should be set to 0.
                     {
-                        REQUIRE(((maskBuffer[static_cast<size_t>(curC)] << (saBitShiftRight - shift * saCounterSize)) >> saBitShiftRight) == 0x0ULL);
+                        REQUIRE(((maskBuffer[DnaAlphabet::code(curC)] << (saBitShiftRight - shift * saCounterSize)) >> saBitShiftRight) == 0x0ULL);
                     }
                     else
                     {
-                        REQUIRE(((maskBuffer[static_cast<size_t>(curC)] << (saBitShiftRight - shift * saCounterSize)) >> saBitShiftRight) == 0x1ULL);
+                        REQUIRE(((maskBuffer[DnaAlphabet::code(curC)] << (saBitShiftRight - shift * saCounterSize)) >> saBitShiftRight) == 0x1ULL);
                     }
                 }
             }
@@ -1,4 +1,5 @@
 #include "catch.hpp"
+#include "naive_matcher.hpp"
 #include "repeat.hpp"
 #include "sopang_whitebox.hpp"
 
@@ -6,6 +7,9 @@
 #include "../parsing.hpp"
 #include "../sopang.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <set>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -21,6 +25,7 @@ namespace
 const string alphabet = "ACGTN";
 
 constexpr int maxPatSize = 64;
+constexpr int maxLongPatSize = 256;
 constexpr int nRandIter = 100;
 
 constexpr int nTextRepeats = 1000;
@@ -33,7 +38,7 @@ TEST_CASE("is matching a single segment correct for whole segment match", "[exac
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGT");
 
@@ -47,7 +52,7 @@ TEST_CASE("is matching a single segment correct for partial segment match", "[ex
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACG", "CGT" })
     {
@@ -64,7 +69,7 @@ TEST_CASE("is matching single letter pattern correct for single match", "[exact]
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,CA}ACN{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "N");
 
@@ -78,7 +83,7 @@ TEST_CASE("is matching single letter pattern correct for multiple matches", "[ex
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,CA}ACN{,A}CGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "A");
     REQUIRE(res.size() == 6);
@@ -95,7 +100,7 @@ TEST_CASE("is matching multiple determinate segments correct for whole segment m
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGT");
     REQUIRE(res.size() == 4);
@@ -112,7 +117,7 @@ TEST_CASE("is matching multiple determinate segments correct for partial segment
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACG", "CGT" })
     {
@@ -142,7 +147,7 @@ TEST_CASE("is matching multiple determinate segments correct for whole segment m
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, det);
     REQUIRE(res.size() == 2);
@@ -167,7 +172,7 @@ TEST_CASE("is matching multiple determinate segments correct for partial segment
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "AACTA", "ACTA", "CTA", "GAACT", "GAAC" })
     {
@@ -197,7 +202,7 @@ TEST_CASE("is matching multiple determinate segments correct for whole segment m
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, det);
     REQUIRE(res.size() == nTextRepeats);
@@ -226,7 +231,7 @@ TEST_CASE("is matching multiple determinate segments correct for partial segment
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray(text, &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "GAACTA", "AACTA", "ACTA", "CTA", "GAACT", "GAAC" })
     {
@@ -246,7 +251,7 @@ TEST_CASE("is matching single indeterminate and determinate segments for spannin
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "CAC", "AAC", "TAA", "TCA" })
     {
@@ -263,7 +268,7 @@ TEST_CASE("is matching single indeterminate and determinate segments for repeate
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C,G,T}{AAA,CCC,GGG,TTT}{ACGT,TGCA}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "TAAAAAC", "TAAAATG", "TCCCCAC", "TCCCCTG", "TGGGGAC", "TGGGGTG", "TTTTTAC", "TTTTTTG" })
     {
@@ -280,7 +285,7 @@ TEST_CASE("is matching multiple indeterminate and determinate segments for spann
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGTA");
     REQUIRE(res.size() == 4);
@@ -297,7 +302,7 @@ TEST_CASE("is matching multiple indeterminate and determinate segments for spann
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("{A,C}ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT,C}ACGT{A,C}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "CAC");
     REQUIRE(res.size() == 3);
@@ -314,7 +319,7 @@ TEST_CASE("is matching multiple short contiguous indeterminate segments correct"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AC{A,G,C}T{,A}{A,T}{C,GC}{A,CA,T}{CA,GG}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "CTATGCTC");
    
@@ -328,7 +333,7 @@ TEST_CASE("is matching pattern starting and ending with text correct", "[exact]"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("{A,C}ACGT{G,C}ACGT{,T}ACGT{GGGG,TTTT,C}AAC{A,G}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "AACG");
     REQUIRE(res.size() == 2);
@@ -343,7 +348,7 @@ TEST_CASE("is matching multiple indeterminate and determinate segments with mult
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "TAC");
     REQUIRE(res.size() == 4);
@@ -360,7 +365,7 @@ TEST_CASE("is matching multiple indeterminate and determinate segments with mult
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,AA,CC,GG}{AA,,CC,GG}{AA,CC,,GG}{AA,CC,GG,}ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     // Only letters from the first and the last segment.
     for (const string &pattern : { "ACGTACGT", "CGTACG", "GTACGT", "GTACG", "GTAC", "TACGT", "TACG", "TAC" })
@@ -396,7 +401,7 @@ TEST_CASE("is matching pattern for contiguous indeterminate segments correct", "
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}{,AA}{,AAAAA,TTTT}{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "AAA");
     REQUIRE(res.size() == 3);
@@ -413,7 +418,7 @@ TEST_CASE("is matching multiple indeterminate and determinate segments with mult
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("AACABBCBBC{A,AAB,ACCA}BB{C,ACABBCBB,CBA}BACABBC{B,CABB,BBC,AACABB,CBC}", &nSegments, &segmentSizes);
 
-    Sopang sopang("ABC");
+    BasicSopang<ProteinAlphabet> sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "CABBCB");
     REQUIRE(res.size() == 4);
@@ -430,7 +435,7 @@ TEST_CASE("is matching pattern length 8 correct", "[exact]")
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGTACGT");
     REQUIRE(res.size() == 3);
@@ -447,7 +452,7 @@ TEST_CASE("is matching pattern length 16 correct", "[exact]")
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}C", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGTACGTACGTACGT");
 
@@ -461,7 +466,7 @@ TEST_CASE("is matching pattern length 32 correct", "[exact]")
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}CGTACGT{A,}CGTACGT{A,CGT}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGTACGTACGTACGTACGTACGTACGTACGT");
 
@@ -475,7 +480,7 @@ TEST_CASE("is matching pattern length 64 correct", "[exact]")
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT{,A,C}ACGT{,A}CGT{,AAAAA,TTTT}ACGT{A,}CGTACGT{A,}CGTACGT{A,}CGTACGTACGTACGTACGTACGTACGTACGT{A,CGT}", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     unordered_set<int> res = sopang.match(segments, nSegments, segmentSizes, "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT");
 
@@ -489,7 +494,7 @@ TEST_CASE("is matching pattern equal to text correct", "[exact]")
         for (int size = 1; size <= maxPatSize; ++size)
         {    
             string text = helpers::genRandomString(size, alphabet);
-            Sopang sopang(alphabet);
+            Sopang sopang;
 
             int nSegments;
             int *segmentSizes;
@@ -506,16 +511,278 @@ TEST_CASE("is matching pattern equal to text correct", "[exact]")
     });
 }
 
+TEST_CASE("is matching flat text correct for random texts", "[exact]")
+{
+    const string smallAlphabet = "ACG";
+    Sopang sopang;
+
+    repeat(nRandIter, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(50, smallAlphabet));
+
+        for (int size = 1; size <= 6; ++size)
+        {
+            const string pattern = helpers::genRandomString(size, smallAlphabet);
+            const unordered_set<int> res = sopang.match(edText, pattern);
+
+            REQUIRE(set<int>(res.begin(), res.end()) == naiveMatch(edText, pattern));
+        }
+    });
+}
+
+TEST_CASE("is matching pattern length 100 correct", "[exact]")
+{
+    const string det = helpers::genRandomString(100, "ACG");
+    const string text = "TTT{A,C}" + det.substr(0, 40) + "{T,}" + det.substr(40, 30) + "{TT,,TTT}" + det.substr(70) + "{A,T}";
+
+    const EdText edText = parsing::parseEdText(text);
+    Sopang sopang;
+
+    const unordered_set<int> res = sopang.match(edText, det);
+
+    REQUIRE(res.size() == 1);
+    REQUIRE(res.count(6) == 1);
+}
+
+TEST_CASE("is matching long patterns correct for random texts", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(500, "AC", 3, 8));
+
+        for (int size = maxPatSize + 1; size <= maxLongPatSize; size += 17)
+        {
+            // Patterns consisting mostly of a single character in order to obtain some matches.
+            string pattern(size, 'A');
+            pattern[helpers::randIntRangeExcluded(0, size - 1, -1)] = 'C';
+
+            const unordered_set<int> res = sopang.match(edText, pattern);
+            REQUIRE(set<int>(res.begin(), res.end()) == naiveMatch(edText, pattern));
+        }
+    });
+}
+
+TEST_CASE("is matching with fixed pattern size kernels correct for random texts", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(500, "AC", 3, 8));
+
+        for (int size : { 7, 8, 9, 16, 32, 63, 64 })
+        {
+            string pattern(size, 'A');
+            pattern[helpers::randIntRangeExcluded(0, size - 1, -1)] = 'C';
+
+            const set<int> expected = naiveMatch(edText, pattern);
+
+            const unordered_set<int> res = sopang.match(edText, pattern);
+            REQUIRE(set<int>(res.begin(), res.end()) == expected);
+
+            FirstNSink firstSink(1);
+            sopang.match(edText, pattern, firstSink);
+
+            REQUIRE(firstSink.indexes.size() == min<size_t>(1, expected.size()));
+
+            if (not expected.empty())
+            {
+                REQUIRE(firstSink.indexes[0] == *expected.begin());
+            }
+        }
+    });
+}
+
+TEST_CASE("is batch matching correct for patterns from a single word", "[exact]")
+{
+    const EdText edText = parsing::parseEdText("ACGT{A,C}ACGT{,A}ACGT{AAAAA,TTTT}ACGT");
+    Sopang sopang;
+
+    const vector<unordered_set<int>> res = sopang.matchBatch(edText, { "ACGT", "ACGTA", "TTTTA", "GGG", "A" });
+    REQUIRE(res.size() == 5);
+
+    REQUIRE(res[0] == unordered_set<int>{ 0, 2, 4, 6 });
+    REQUIRE(res[1] == unordered_set<int>{ 1, 3, 4, 5 });
+    REQUIRE(res[2] == unordered_set<int>{ 6 });
+    REQUIRE(res[3] == unordered_set<int>{ });
+    REQUIRE(res[4] == unordered_set<int>{ 0, 1, 2, 3, 4, 5, 6 });
+
+    vector<SortedVectorSink> sinks(2);
+    sopang.matchBatch(edText, { "ACGT", "ACGTA" }, sinks);
+
+    REQUIRE(sinks[0].indexes == vector<int>{ 0, 2, 4, 6 });
+    REQUIRE(sinks[1].indexes == vector<int>{ 1, 3, 4, 5 });
+
+    vector<FirstNSink> firstNSinks(2, FirstNSink(2));
+    sopang.matchBatch(edText, { "ACGT", "ACGTA" }, firstNSinks);
+
+    REQUIRE(firstNSinks[0].indexes == vector<int>{ 0, 2 });
+    REQUIRE(firstNSinks[1].indexes == vector<int>{ 1, 3 });
+}
+
+TEST_CASE("is batch matching equivalent to matching each pattern separately", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(200, "ACG"));
+        vector<string> patterns;
+
+        for (int size = 1; size <= maxPatSize; size += 3)
+        {
+            patterns.push_back(helpers::genRandomString(size, "ACG"));
+            patterns.push_back(helpers::genRandomString(1 + size % 5, "ACG"));
+        }
+
+        const vector<unordered_set<int>> res = sopang.matchBatch(edText, patterns);
+        REQUIRE(res.size() == patterns.size());
+
+        for (size_t iP = 0; iP < patterns.size(); ++iP)
+        {
+            REQUIRE(res[iP] == sopang.match(edText, patterns[iP]));
+        }
+    });
+}
+
+TEST_CASE("is parallel matching equivalent to sequential matching for random texts", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        // Short texts with variants up to the pattern size, so that both anchored and reconciled chunks occur.
+        const EdText edText = parsing::parseEdText(genRandomEdText(300, "ACG", 3, 6));
+
+        for (int size = 1; size <= 12; ++size)
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+            const unordered_set<int> expected = sopang.match(edText, pattern);
+
+            for (int nThreads : { 1, 2, 3, 8, 64 })
+            {
+                REQUIRE(sopang.matchParallel(edText, pattern, nThreads) == expected);
+            }
+        }
+    });
+}
+
+TEST_CASE("is parallel matching correct for a pattern spanning chunks without anchors", "[exact]")
+{
+    // All deterministic segments are shorter than m - 1, hence every chunk boundary has to be reconciled.
+    string text;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        text += "A{C,G}";
+    }
+
+    const EdText edText = parsing::parseEdText(text);
+    Sopang sopang;
+
+    for (int nThreads : { 2, 4, 7 })
+    {
+        const unordered_set<int> res = sopang.matchParallel(edText, "ACAGACAG", nThreads);
+        REQUIRE(set<int>(res.begin(), res.end()) == naiveMatch(edText, "ACAGACAG"));
+    }
+}
+
+TEST_CASE("is matching with result sinks correct for random texts", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(200, "ACG"));
+
+        for (int size : { 1, 3, 5, 80 })
+        {
+            const string pattern = size == 80 ? string(size, 'A') : helpers::genRandomString(size, "ACG");
+            const set<int> expected = naiveMatch(edText, pattern);
+
+            SortedVectorSink vectorSink;
+            sopang.match(edText, pattern, vectorSink);
+
+            REQUIRE(vectorSink.indexes == vector<int>(expected.begin(), expected.end()));
+
+            BitmapSink bitmapSink(edText.nSegments());
+            sopang.match(edText, pattern, bitmapSink);
+
+            REQUIRE(bitmapSink.count() == static_cast<int>(expected.size()));
+            REQUIRE(bitmapSink.toVector() == vectorSink.indexes);
+
+            vector<int> callbackRes;
+            CallbackSink callbackSink([&callbackRes](int segmentIdx) { callbackRes.push_back(segmentIdx); });
+            sopang.matchParallel(edText, pattern, 4, callbackSink);
+
+            REQUIRE(callbackRes == vectorSink.indexes);
+        }
+    });
+}
+
+TEST_CASE("is matching with count, exists and first-n sinks correct for random texts", "[exact]")
+{
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(200, "ACG"));
+
+        for (int size : { 1, 2, 4, 70 })
+        {
+            const string pattern = size == 70 ? string(size, 'A') : helpers::genRandomString(size, "ACG");
+            const set<int> expected = naiveMatch(edText, pattern);
+
+            CountSink countSink;
+            sopang.match(edText, pattern, countSink);
+
+            REQUIRE(countSink.count == static_cast<int>(expected.size()));
+
+            ExistsSink existsSink;
+            sopang.matchParallel(edText, pattern, 3, existsSink);
+
+            REQUIRE(existsSink.exists == not expected.empty());
+
+            for (int n : { 1, 2, 5 })
+            {
+                FirstNSink firstNSink(n);
+                sopang.match(edText, pattern, firstNSink);
+
+                const vector<int> expectedFirstN(expected.begin(), next(expected.begin(), min(static_cast<size_t>(n), expected.size())));
+                REQUIRE(firstNSink.indexes == expectedFirstN);
+
+                FirstNSink parallelFirstNSink(n);
+                sopang.matchParallel(edText, pattern, 4, parallelFirstNSink);
+
+                REQUIRE(parallelFirstNSink.indexes == expectedFirstN);
+            }
+        }
+    });
+}
+
+TEST_CASE("is matching with an exists sink stopping at the first match", "[exact]")
+{
+    const EdText edText = parsing::parseEdText("ACGT{A,C}ACGT{,A}ACGT");
+    Sopang sopang;
+
+    int nCalls = 0;
+    CallbackSink callbackSink([&nCalls](int) { nCalls += 1; });
+
+    sopang.match(edText, "ACGT", callbackSink);
+    REQUIRE(nCalls == 3);
+
+    ExistsSink existsSink;
+    sopang.match(edText, "ACGT", existsSink);
+
+    REQUIRE(existsSink.exists);
+    REQUIRE(existsSink.full());
+}
+
 TEST_CASE("is filling mask buffer correct for a predefined pattern", "[exact]")
 {
     const string pattern = "ACAACGT";
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
     SopangWhitebox::fillPatternMaskBuffer(sopang, pattern);
 
     const uint64_t *maskBuffer = SopangWhitebox::getMaskBuffer(sopang);
 
-    uint64_t maskA = maskBuffer[static_cast<size_t>('A')];
+    uint64_t maskA = maskBuffer[DnaAlphabet::code('A')];
     const vector<uint64_t> expectedA { 0x0, 0x1, 0x0, 0x0, 0x1, 0x1, 0x1 };
 
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -523,7 +790,7 @@ TEST_CASE("is filling mask buffer correct for a predefined pattern", "[exact]")
         REQUIRE(((maskA & (0x1ULL << i)) >> i) == expectedA[i]);
     }
 
-    uint64_t maskC = maskBuffer[static_cast<size_t>('C')];
+    uint64_t maskC = maskBuffer[DnaAlphabet::code('C')];
     const vector<uint64_t> expectedC { 0x1, 0x0, 0x1, 0x1, 0x0, 0x1, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -531,7 +798,7 @@ TEST_CASE("is filling mask buffer correct for a predefined pattern", "[exact]")
         REQUIRE(((maskC & (0x1ULL << i)) >> i) == expectedC[i]);
     }
 
-    uint64_t maskG = maskBuffer[static_cast<size_t>('G')];
+    uint64_t maskG = maskBuffer[DnaAlphabet::code('G')];
     const vector<uint64_t> expectedG { 0x1, 0x1, 0x1, 0x1, 0x1, 0x0, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -539,7 +806,7 @@ TEST_CASE("is filling mask buffer correct for a predefined pattern", "[exact]")
         REQUIRE(((maskG & (0x1ULL << i)) >> i) == expectedG[i]);
     }
 
-    uint64_t maskT = maskBuffer[static_cast<size_t>('T')];
+    uint64_t maskT = maskBuffer[DnaAlphabet::code('T')];
     const vector<uint64_t> expectedT { 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x0 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -547,7 +814,7 @@ TEST_CASE("is filling mask buffer correct for a predefined pattern", "[exact]")
         REQUIRE(((maskT & (0x1ULL << i)) >> i) == expectedT[i]);
     }
 
-    uint64_t maskN = maskBuffer[static_cast<size_t>('N')];
+    uint64_t maskN = maskBuffer[DnaAlphabet::code('N')];
     const vector<uint64_t> expectedN { 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1 };
     
     for (size_t i = 0; i < pattern.size(); ++i)
@@ -565,7 +832,7 @@ TEST_CASE("is filling mask buffer correct for repeated same character in pattern
             string pattern = "";
             repeat(size, [c, &pattern] { pattern += c; });
 
-            Sopang sopang(alphabet);
+            Sopang sopang;
             SopangWhitebox::fillPatternMaskBuffer(sopang, pattern);
 
             const uint64_t *maskBuffer = SopangWhitebox::getMaskBuffer(sopang);
@@ -577,11 +844,11 @@ TEST_CASE("is filling mask buffer correct for repeated same character in pattern
                 {
                     if (curC == c) // Corresponding occurrences should be set to 0.
                     {
-                        REQUIRE((maskBuffer[static_cast<size_t>(curC)] & m) == 0x0);
+                        REQUIRE((maskBuffer[DnaAlphabet::code(curC)] & m) == 0x0);
                     }
                     else
                     {
-                        REQUIRE((maskBuffer[static_cast<size_t>(curC)] & m) != 0x0);
+                        REQUIRE((maskBuffer[DnaAlphabet::code(curC)] & m) != 0x0);
                     }
                 }
                 m <<= 1;
@@ -1,8 +1,15 @@
 #include "catch.hpp"
+#include "naive_matcher.hpp"
+#include "repeat.hpp"
 
+#include "../helpers.hpp"
 #include "../parsing.hpp"
 #include "../sopang.hpp"
 
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -17,6 +24,27 @@ namespace
 
 const string alphabet = "ACGTN";
 
+constexpr int nRandIter = 100;
+
+/** Text with deterministic, empty and multi-character variants on which engines for matching with sources are checked against each other. */
+const string predefinedText = "AA{ANT,AC,GGT,}CGGA{CGAAA,}{AAC,TC}";
+constexpr int predefinedSourceCount = 4;
+
+const vector<string> predefinedPatterns { "A", "AA", "GGA", "ACG", "AACG", "AANTCGGACGAAAAAC", "AACGGACG", "CGGATC", "ACCGGAAAC", "AAGGTCGGATC", "AACGGAT", "TT" };
+
+/** Source map for predefinedText, each source takes a different variant of the first non-deterministic segment. */
+Sopang::SourceMap genPredefinedSourceMap()
+{
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(predefinedSourceCount, { 0 }), SourceSet(predefinedSourceCount, { 1 }), SourceSet(predefinedSourceCount, { 2 }), SourceSet(predefinedSourceCount, { 3 }) },
+        { SourceSet(predefinedSourceCount, { 0 }), SourceSet(predefinedSourceCount, { 1, 2, 3 }) },
+        { SourceSet(predefinedSourceCount, { 0, 1 }), SourceSet(predefinedSourceCount, { 2, 3 }) } };
+    const vector<int> segmentSizes { 1, 4, 1, 2, 2 };
+
+    return parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+}
+
 }
 
 TEST_CASE("is matching a single segment with empty sources correct", "[sources]")
@@ -25,7 +53,7 @@ TEST_CASE("is matching a single segment with empty sources correct", "[sources]"
     int *segmentSizes;
     const string *const *segments = parsing::parseTextArray("ACGT", &nSegments, &segmentSizes);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     for (const string &pattern : { "ACGT", "ACG", "CGT", "AC", "CG", "GT", "A", "C", "G", "T" })
     {
@@ -49,7 +77,7 @@ TEST_CASE("is matching sources for 3 non-deterministic segments correct", "[sour
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -83,7 +111,7 @@ TEST_CASE("is matching sources for 3 segments with deterministic correct", "[sou
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -117,7 +145,7 @@ TEST_CASE("is matching sources for 3 segments with deterministic with higher sou
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, {  SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -152,7 +180,7 @@ TEST_CASE("is matching sources for 4 segments with deterministic correct", "[sou
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -199,7 +227,7 @@ TEST_CASE("is matching sources for 3 non-deterministic segments multiple matches
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) }, {  SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 2 }) }, { SourceSet(sourceCount, { 0, 2 }), SourceSet(sourceCount, { 1 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -228,7 +256,7 @@ TEST_CASE("is matching sources for 5 segments with deterministic and empty varia
     const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }), SourceSet(sourceCount, { 3 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2, 3 }) }, { SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 2, 3 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -297,7 +325,7 @@ TEST_CASE("is matching sources for 5 segments with deterministic and empty varia
                                                     { SourceSet(sourceCount, { 0, 2 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 3 }) }, { SourceSet(sourceCount, { 0 , 3 }), SourceSet(sourceCount, { 1, 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -329,7 +357,7 @@ TEST_CASE("is matching sources for 5 segments with deterministic and empty varia
                                                     { SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 3 }), SourceSet(sourceCount, { 0, 2 }) }, { SourceSet(sourceCount, { 0, 3 }), SourceSet(sourceCount, { 1, 2 }) } };
     const auto sourceMap = parsing::sourcesToSourceMap(nSegments, segmentSizes, sources);
 
-    Sopang sopang(alphabet);
+    Sopang sopang;
 
     const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
         const auto resSet = sopang.matchWithSourcesVerify(segments, nSegments, segmentSizes, sourceMap, sourceCount, pattern);
@@ -348,5 +376,509 @@ TEST_CASE("is matching sources for 5 segments with deterministic and empty varia
     testMatch("ACACAT", { }, { }); // 1-01-02-12 | 01-3-12
 }
 
+TEST_CASE("is matching sources for a pattern longer than a word correct", "[sources]")
+{
+    const string det = string(60, 'A') + string(60, 'C');
+    const EdText edText = parsing::parseEdText("{G,T}" + det + "{GG,T,}" + det + "{A,C}");
+
+    constexpr int sourceCount = 3;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) },
+                                              { SourceSet(sourceCount, { 0, 2 }), SourceSet(sourceCount, { 1 }) } };
+    const vector<int> segmentSizes { 2, 1, 3, 1, 2 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    const auto testMatch = [&](const string &pattern, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
+        const auto resSet = sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, pattern);
+        REQUIRE(resSet == expectedSet);
+
+        const auto resMap = sopang.matchWithSources(edText, sourceMap, sourceCount, pattern);
+        REQUIRE(resMap == expectedMap);
+    };
+
+    testMatch(det + "GG", { 2 }, { {2, {0}} });
+    testMatch(det + "T" + det, { 3 }, { {3, {1}} });
+    testMatch(det + det, { 3 }, { {3, {2}} });
+    testMatch(det + det + "C", { }, { });
+    testMatch(det + det + "A", { 4 }, { {4, {2}} });
+    testMatch("T" + det + "T" + det, { 3 }, { {3, {1}} });
+    testMatch("G" + det + "T" + det, { }, { });
+}
+
+TEST_CASE("is matching sources checking characters of deterministic segments", "[sources]")
+{
+    const EdText edText = parsing::parseEdText("AC{G,CG}T");
+
+    constexpr int sourceCount = 2;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) } };
+    const vector<int> segmentSizes { 1, 2, 1 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    // Source 1 spells ACCGT, its path reaches the first segment with a different pattern index than the path of source 0.
+    REQUIRE(sopang.matchWithSources(edText, sourceMap, sourceCount, "ACGT") == unordered_map<int, SourceSet>{ {2, {0}} });
+    REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, "ACGT") == 1);
+
+    REQUIRE(sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, "CCGT") == unordered_set<int>{ 2 });
+    REQUIRE(sopang.matchWithSources(edText, sourceMap, sourceCount, "CCGT") == unordered_map<int, SourceSet>{ {2, {1}} });
+    REQUIRE(sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, "TCGT").empty());
+}
+
+TEST_CASE("is verifying sources with a sorted vector sink correct", "[sources]")
+{
+    const EdText edText = parsing::parseEdText("{A,C}GT{A,C}GT{A,C}");
+
+    constexpr int sourceCount = 2;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) },
+                                              { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) } };
+    const vector<int> segmentSizes { 2, 1, 2, 1, 2 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    SortedVectorSink sink;
+    sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, "GTA", sink);
+    REQUIRE(sink.indexes == vector<int>{ 2, 4 });
+
+    sink.indexes.clear();
+    sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, "AGTC", sink);
+    REQUIRE(sink.indexes.empty());
+
+    sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, "CGTC", sink);
+    REQUIRE(sink.indexes == vector<int>{ 2, 4 });
+}
+
+TEST_CASE("is counting matching sources correct", "[sources]")
+{
+    const EdText edText = parsing::parseEdText("{A,C}GT{A,C,G}GT{A,C}");
+
+    constexpr int sourceCount = 4;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 2, 3 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1, 2 }), SourceSet(sourceCount, { 3 }) },
+                                              { SourceSet(sourceCount, { 0, 2 }), SourceSet(sourceCount, { 1, 3 }) } };
+    const vector<int> segmentSizes { 2, 1, 3, 1, 2 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    for (const string &pattern : { "AGTA", "CGTC", "GTC", "TGG", "TAGTA", "AGTCGTA", "A", "GT" })
+    {
+        const auto resMap = sopang.matchWithSources(edText, sourceMap, sourceCount, pattern);
+
+        SourceSet expected(sourceCount);
+        bool deterministicMatch = false;
+
+        for (const auto &kv : resMap)
+        {
+            deterministicMatch |= kv.second.empty();
+            expected |= kv.second;
+        }
+
+        const int expectedCount = deterministicMatch ? sourceCount : expected.count();
+        REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, pattern) == expectedCount);
+    }
+
+    REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, "AGTA") == 1);
+    REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, "GT") == sourceCount);
+    REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, "TT") == 0);
+}
+
+TEST_CASE("is forward matching with sources correct for a predefined text", "[sources]")
+{
+    const EdText edText = parsing::parseEdText(predefinedText);
+    const Sopang::SourceMap sourceMap = genPredefinedSourceMap();
+
+    using SourceSet = Sopang::SourceSet;
+
+    Sopang sopang;
+
+    for (const string &pattern : predefinedPatterns)
+    {
+        const auto resMap = sopang.matchWithSources(edText, sourceMap, predefinedSourceCount, pattern);
+        REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, predefinedSourceCount, pattern) == resMap);
+
+        unordered_set<int> expectedSet;
+
+        for (const auto &kv : resMap)
+        {
+            expectedSet.insert(kv.first);
+        }
+
+        REQUIRE(sopang.matchWithSourcesVerifyForward(edText, sourceMap, predefinedSourceCount, pattern) == expectedSet);
+        REQUIRE(sopang.countMatchingSourcesForward(edText, sourceMap, predefinedSourceCount, pattern) == sopang.countMatchingSources(edText, sourceMap, predefinedSourceCount, pattern));
+    }
+
+    REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, predefinedSourceCount, "CGGATC") == unordered_map<int, SourceSet>{ {4, {2, 3}} });
+    REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, predefinedSourceCount, "GGA") == unordered_map<int, SourceSet>{ {2, SourceSet(predefinedSourceCount)} });
+    REQUIRE(sopang.countMatchingSourcesForward(edText, sourceMap, predefinedSourceCount, "AAGGTCGGATC") == 1);
+}
+
+TEST_CASE("is forward matching with sources correct for a word-sized pattern", "[sources]")
+{
+    // The pattern spans many non-deterministic segments, so that source sets of all prefixes are carried until the word end.
+    string text, pattern;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        text += "ACG{T,A}";
+        pattern += (i % 2 == 0) ? "ACGT" : "ACGA";
+    }
+
+    const EdText edText = parsing::parseEdText(text);
+    REQUIRE(pattern.size() == Sopang::maxPatternSourcesForwardSize);
+
+    constexpr int sourceCount = 3;
+    using SourceSet = Sopang::SourceSet;
+
+    vector<vector<SourceSet>> sources;
+    vector<int> segmentSizes;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        // Source 0 follows the pattern, source 1 takes T everywhere and source 2 deviates only in the last segment.
+        const bool patternTakesT = (i % 2 == 0);
+        SourceSet sourcesT(sourceCount, { 1 }), sourcesA(sourceCount);
+
+        (patternTakesT ? sourcesT : sourcesA).set(0);
+        (patternTakesT == (i != 15) ? sourcesT : sourcesA).set(2);
+
+        sources.push_back({ sourcesT, sourcesA });
+        segmentSizes.insert(segmentSizes.end(), { 1, 2 });
+    }
+
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, sourceCount, pattern) == unordered_map<int, SourceSet>{ {31, {0}} });
+    REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, sourceCount, pattern) == sopang.matchWithSources(edText, sourceMap, sourceCount, pattern));
+    REQUIRE(sopang.countMatchingSourcesForward(edText, sourceMap, sourceCount, pattern) == 1);
+}
+
+TEST_CASE("are haplotype blocks correct for a predefined text", "[sources]")
+{
+    const EdText edText = parsing::parseEdText(predefinedText);
+    const Sopang::SourceMap sourceMap = genPredefinedSourceMap();
+
+    using SourceSet = Sopang::SourceSet;
+
+    // The first non-deterministic segment already splits the sources into 4 classes, hence a limit of 4 yields a single block.
+    const Sopang::HaplotypeIndex singleBlock(edText, sourceMap, predefinedSourceCount, 4);
+
+    REQUIRE(singleBlock.nBlocks() == 1);
+    REQUIRE(singleBlock.nClasses() == 4);
+
+    REQUIRE(string(singleBlock.classText(0), singleBlock.classSize(0)) == "AAANTCGGACGAAAAAC");
+    REQUIRE(singleBlock.classSources(0) == SourceSet(predefinedSourceCount, { 0 }));
+    REQUIRE(string(singleBlock.classText(3), singleBlock.classSize(3)) == "AACGGATC");
+    REQUIRE(singleBlock.classSources(3) == SourceSet(predefinedSourceCount, { 3 }));
+
+    const size_t *segmentEnds = singleBlock.classSegmentEnds(3);
+    REQUIRE(vector<size_t>(segmentEnds, segmentEnds + 5) == vector<size_t>{ 2, 2, 6, 6, 8 });
+
+    // With at most 2 classes, each non-deterministic segment starts a new block.
+    const Sopang::HaplotypeIndex blocks(edText, sourceMap, predefinedSourceCount, 2);
+
+    REQUIRE(blocks.nBlocks() == 3);
+    REQUIRE(blocks.blockEnd(0) == 3);
+    REQUIRE(blocks.blockEnd(1) == 4);
+    REQUIRE(blocks.classEnd(0) - blocks.classBegin(0) == 4);
+    REQUIRE(blocks.classEnd(1) - blocks.classBegin(1) == 2);
+
+    Sopang sopang;
+
+    for (const Sopang::HaplotypeIndex *haplotypeIndex : { &singleBlock, &blocks })
+    {
+        for (const string &pattern : predefinedPatterns)
+        {
+            REQUIRE(sopang.matchWithSourcesHaplotype(edText, *haplotypeIndex, pattern) == sopang.matchWithSources(edText, sourceMap, predefinedSourceCount, pattern));
+            REQUIRE(sopang.matchWithSourcesVerifyHaplotype(edText, *haplotypeIndex, pattern) == sopang.matchWithSourcesVerify(edText, sourceMap, predefinedSourceCount, pattern));
+            REQUIRE(sopang.countMatchingSourcesHaplotype(edText, *haplotypeIndex, pattern) == sopang.countMatchingSources(edText, sourceMap, predefinedSourceCount, pattern));
+        }
+    }
+}
+
+TEST_CASE("is building haplotype blocks throwing for a source in multiple variants", "[sources]")
+{
+    const EdText edText = parsing::parseEdText("AC{A,C,G}T");
+
+    constexpr int sourceCount = 3;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0, 1 }), SourceSet(sourceCount, { 1 }), SourceSet(sourceCount, { 2 }) } };
+    const vector<int> segmentSizes { 1, 3, 1 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    REQUIRE_THROWS_AS(Sopang::HaplotypeIndex(edText, sourceMap, sourceCount), runtime_error);
+}
+
+TEST_CASE("is PBWT index correct for a predefined text", "[sources]")
+{
+    const EdText edText = parsing::parseEdText(predefinedText);
+    const Sopang::SourceMap sourceMap = genPredefinedSourceMap();
+
+    using SourceSet = Sopang::SourceSet;
+
+    const Sopang::PbwtIndex pbwtIndex(edText, sourceMap, predefinedSourceCount);
+
+    REQUIRE(pbwtIndex.nColumns() == 3);
+    REQUIRE(pbwtIndex.column(0) == -1);
+    REQUIRE(pbwtIndex.column(3) == 1);
+
+    const auto calcPathSources = [&](int firstColumn, const vector<int> &path) {
+        Sopang::PbwtIndex::Interval interval = pbwtIndex.fullInterval();
+
+        for (int column = firstColumn + static_cast<int>(path.size()) - 1; column >= firstColumn; --column)
+        {
+            interval = pbwtIndex.extend(interval, column, path[column - firstColumn]);
+        }
+
+        SourceSet res(predefinedSourceCount);
+        pbwtIndex.addSources(interval, res);
+
+        return res;
+    };
+
+    REQUIRE(calcPathSources(0, { 3, 1, 1 }) == SourceSet(predefinedSourceCount, { 3 }));
+    REQUIRE(calcPathSources(1, { 1, 1 }) == SourceSet(predefinedSourceCount, { 2, 3 }));
+    REQUIRE(calcPathSources(1, { 1, 0 }) == SourceSet(predefinedSourceCount, { 1 }));
+    REQUIRE(calcPathSources(0, { 0, 1 }) == SourceSet(predefinedSourceCount));
+    REQUIRE(calcPathSources(2, { }) == SourceSet(predefinedSourceCount, { 0, 1, 2, 3 }));
+
+    Sopang sopang;
+
+    for (const string &pattern : predefinedPatterns)
+    {
+        REQUIRE(sopang.matchWithSourcesVerifyPbwt(edText, pbwtIndex, pattern) == sopang.matchWithSourcesVerify(edText, sourceMap, predefinedSourceCount, pattern));
+    }
+}
+
+TEST_CASE("is PBWT index correct for random paths over many columns and sources", "[sources]")
+{
+    // More columns than between sampled orderings and more runs than between rank samples.
+    constexpr int sourceCount = 300;
+    using SourceSet = Sopang::SourceSet;
+
+    mt19937 mt(random_device{}());
+
+    repeat(nRandIter / 20, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(300, "ACG", 3, 2));
+        const Sopang::SourceMap sourceMap = genRandomSourceMap(edText, sourceCount);
+
+        const Sopang::PbwtIndex pbwtIndex(edText, sourceMap, sourceCount);
+
+        vector<int> columnSegments;
+
+        for (int iS = 0; iS < edText.nSegments(); ++iS)
+        {
+            if (pbwtIndex.column(iS) >= 0)
+            {
+                columnSegments.push_back(iS);
+            }
+        }
+
+        REQUIRE(pbwtIndex.nColumns() == static_cast<int>(columnSegments.size()));
+
+        for (int lastColumn = pbwtIndex.nColumns() - 1; lastColumn >= 0; lastColumn -= 7)
+        {
+            Sopang::PbwtIndex::Interval interval = pbwtIndex.fullInterval();
+            SourceSet expected(sourceCount);
+            expected.set();
+
+            // Paths follow a random source for a while, so that their intervals do not become empty right away.
+            const int followedSource = mt() % sourceCount;
+
+            for (int column = lastColumn; column >= max(0, lastColumn - 80); --column)
+            {
+                const int segmentIdx = columnSegments[column];
+                int variantIdx = mt() % edText.segmentSize(segmentIdx);
+
+                if (column > lastColumn - 3)
+                {
+                    for (int iV = 0; iV < edText.segmentSize(segmentIdx); ++iV)
+                    {
+                        if (sourceMap.sources(segmentIdx, iV).test(followedSource))
+                        {
+                            variantIdx = iV;
+                        }
+                    }
+                }
+
+                interval = pbwtIndex.extend(interval, column, variantIdx);
+                expected = (expected & sourceMap.sources(segmentIdx, variantIdx));
+
+                SourceSet res(sourceCount);
+                pbwtIndex.addSources(interval, res);
+
+                REQUIRE(res == expected);
+                REQUIRE(interval.end - interval.begin == expected.count());
+            }
+        }
+
+        Sopang sopang;
+
+        for (int size : { 3, 6, 10 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+            REQUIRE(sopang.matchWithSourcesVerifyPbwt(edText, pbwtIndex, pattern) == sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, pattern));
+        }
+    });
+}
+
+TEST_CASE("is approx matching with sources correct for a predefined text", "[sources]")
+{
+    const EdText edText = parsing::parseEdText("{A,C}GT{A,C}GT{A,C}");
+
+    constexpr int sourceCount = 2;
+    using SourceSet = Sopang::SourceSet;
+
+    const vector<vector<SourceSet>> sources { { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) }, { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) },
+                                              { SourceSet(sourceCount, { 0 }), SourceSet(sourceCount, { 1 }) } };
+    const vector<int> segmentSizes { 2, 1, 2, 1, 2 };
+    const auto sourceMap = parsing::sourcesToSourceMap(segmentSizes.size(), segmentSizes.data(), sources);
+
+    Sopang sopang;
+
+    const auto testMatch = [&](const string &pattern, int k, const unordered_set<int> &expectedSet, const unordered_map<int, SourceSet> &expectedMap) {
+        REQUIRE(sopang.matchApproxWithSourcesVerify(edText, sourceMap, sourceCount, pattern, k) == expectedSet);
+        REQUIRE(sopang.matchApproxWithSources(edText, sourceMap, sourceCount, pattern, k) == expectedMap);
+    };
+
+    testMatch("AGTC", 1, { 2, 4 }, { {2, {0, 1}}, {4, {0, 1}} });
+    testMatch("AGTAGTC", 1, { 4 }, { {4, {0}} });
+    testMatch("AGTAGTC", 2, { 4 }, { {4, {0, 1}} });
+    // The path C, A, C has no mismatches but no source follows it.
+    testMatch("CGTAGTC", 1, { 4 }, { {4, {1}} });
+    testMatch("CGTAGTC", 2, { 4 }, { {4, {0, 1}} });
+    testMatch("GGGAGTC", 1, { }, { });
+    // Mismatches in deterministic segments are counted as well.
+    testMatch("ATTAGTA", 1, { 4 }, { {4, {0}} });
+    testMatch("ATTAGAA", 1, { }, { });
+}
+
+TEST_CASE("is approx matching with sources correct for random texts", "[sources]")
+{
+    constexpr int sourceCount = 6;
+    using SourceSet = Sopang::SourceSet;
+
+    Sopang sopang;
+
+    repeat(nRandIter / 10, [&] {
+        const EdText edText = parsing::parseEdText(genRandomEdText(100, "ACG", 3, 4));
+        const Sopang::SourceMap sourceMap = genRandomSourceMap(edText, sourceCount);
+
+        for (int size : { 3, 8, 20 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+
+            for (int k : { 1, 2, 6 })
+            {
+                const map<int, set<int>> expected = naiveMatchSources(edText, sourceMap, sourceCount, pattern, k);
+
+                const unordered_set<int> resSet = sopang.matchApproxWithSourcesVerify(edText, sourceMap, sourceCount, pattern, k);
+                const unordered_map<int, SourceSet> resMap = sopang.matchApproxWithSources(edText, sourceMap, sourceCount, pattern, k);
+
+                REQUIRE(resSet.size() == expected.size());
+                REQUIRE(resMap.size() == expected.size());
+
+                for (const auto &kv : expected)
+                {
+                    REQUIRE(resSet.count(kv.first) == 1);
+                    REQUIRE(resMap.count(kv.first) == 1);
+
+                    // An empty set denotes a match within a deterministic segment, i.e. all sources.
+                    const SourceSet &sources = resMap.at(kv.first);
+
+                    if (not sources.empty())
+                    {
+                        for (int iSource = 0; iSource < sourceCount; ++iSource)
+                        {
+                            REQUIRE(sources.test(iSource) == (kv.second.count(iSource) == 1));
+                        }
+                    }
+                    else
+                    {
+                        REQUIRE(static_cast<int>(kv.second.size()) == sourceCount);
+                    }
+                }
+            }
+        }
+    });
+}
+
+TEST_CASE("is matching sources correct for random texts", "[sources]")
+{
+    constexpr int sourceCount = 6;
+    using SourceSet = Sopang::SourceSet;
+
+    // Breadcrumbs prune verification but do not change its results.
+    Sopang sopang, sopangBreadcrumbs;
+    sopangBreadcrumbs.setBreadcrumbs(true);
+
+    repeat(nRandIter / 10, [&] {
+        // Many short variants, so that the number of paths grows quickly and leaves reaching the same pattern index are merged.
+        const EdText edText = parsing::parseEdText(genRandomEdText(100, "ACG", 4, 2));
+        const Sopang::SourceMap sourceMap = genRandomSourceMap(edText, sourceCount);
+
+        // Blocks with a single class (i.e. of a single segment with more variants) up to blocks with a class for each source.
+        const vector<Sopang::HaplotypeIndex> haplotypeIndexes { Sopang::HaplotypeIndex(edText, sourceMap, sourceCount, 1),
+            Sopang::HaplotypeIndex(edText, sourceMap, sourceCount, 3), Sopang::HaplotypeIndex(edText, sourceMap, sourceCount, sourceCount) };
+        const Sopang::PbwtIndex pbwtIndex(edText, sourceMap, sourceCount);
+
+        for (int size : { 2, 5, 12, 30 })
+        {
+            const string pattern = helpers::genRandomString(size, "ACG");
+            const map<int, set<int>> expected = naiveMatchSources(edText, sourceMap, sourceCount, pattern);
+
+            const unordered_set<int> resSet = sopang.matchWithSourcesVerify(edText, sourceMap, sourceCount, pattern);
+            const unordered_map<int, SourceSet> resMap = sopang.matchWithSources(edText, sourceMap, sourceCount, pattern);
+
+            REQUIRE(resSet.size() == expected.size());
+            REQUIRE(resMap.size() == expected.size());
+
+            set<int> expectedSources;
+
+            for (const auto &kv : expected)
+            {
+                REQUIRE(resSet.count(kv.first) == 1);
+                REQUIRE(resMap.count(kv.first) == 1);
+
+                // An empty set denotes a match within a deterministic segment, i.e. all sources.
+                const SourceSet &sources = resMap.at(kv.first);
+                REQUIRE((sources.empty() ? static_cast<int>(kv.second.size()) == sourceCount : sources == kv.second));
+
+                expectedSources.insert(kv.second.begin(), kv.second.end());
+            }
+
+            REQUIRE(sopang.countMatchingSources(edText, sourceMap, sourceCount, pattern) == static_cast<int>(expectedSources.size()));
+
+            REQUIRE(sopangBreadcrumbs.matchWithSourcesVerify(edText, sourceMap, sourceCount, pattern) == resSet);
+            REQUIRE(sopangBreadcrumbs.matchWithSources(edText, sourceMap, sourceCount, pattern) == resMap);
+            REQUIRE(sopangBreadcrumbs.countMatchingSources(edText, sourceMap, sourceCount, pattern) == static_cast<int>(expectedSources.size()));
+
+            REQUIRE(sopang.matchWithSourcesVerifyForward(edText, sourceMap, sourceCount, pattern) == resSet);
+            REQUIRE(sopang.matchWithSourcesForward(edText, sourceMap, sourceCount, pattern) == resMap);
+            REQUIRE(sopang.countMatchingSourcesForward(edText, sourceMap, sourceCount, pattern) == static_cast<int>(expectedSources.size()));
+
+            for (const Sopang::HaplotypeIndex &haplotypeIndex : haplotypeIndexes)
+            {
+                REQUIRE(sopang.matchWithSourcesVerifyHaplotype(edText, haplotypeIndex, pattern) == resSet);
+                REQUIRE(sopang.matchWithSourcesHaplotype(edText, haplotypeIndex, pattern) == resMap);
+                REQUIRE(sopang.countMatchingSourcesHaplotype(edText, haplotypeIndex, pattern) == static_cast<int>(expectedSources.size()));
+            }
+
+            REQUIRE(sopang.matchWithSourcesVerifyPbwt(edText, pbwtIndex, pattern) == resSet);
+        }
+    });
+}
 
 } // namespace sopang
@@ -31,9 +31,10 @@ public:
         return sopang.maskBuffer;
     }
 
-    inline static int getMaxSourceCount(const Sopang &sopang)
+    template<size_t B>
+    inline static uint64_t minCounters(uint64_t x, uint64_t y)
     {
-        return sopang.maxSourceCount;
+        return Sopang::minCounters<B>(x, y);
     }
 
     inline static size_t getWordSize(const Sopang &sopang) 
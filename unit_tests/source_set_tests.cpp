@@ -0,0 +1,262 @@
+#include "catch.hpp"
+#include "repeat.hpp"
+
+#include "../source_set.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+
+using namespace std;
+
+namespace sopang
+{
+
+namespace
+{
+
+constexpr int nRandIter = 3;
+
+/** Source counts covering an inline word, a single container and multiple containers. */
+const int sourceCounts[] = { 5, 64, 100, 5'000, 70'000 };
+
+set<int> genRandomSet(int maxCount, double density, mt19937 &mt)
+{
+    bernoulli_distribution dist(density);
+    set<int> ret;
+
+    for (int n = 0; n < maxCount; ++n)
+    {
+        if (dist(mt))
+        {
+            ret.insert(ret.end(), n);
+        }
+    }
+
+    return ret;
+}
+
+SourceSet toSourceSet(int maxCount, const set<int> &elements)
+{
+    SourceSet ret(maxCount);
+
+    for (const int n : elements)
+    {
+        ret.set(n);
+    }
+
+    return ret;
+}
+
+}
+
+TEST_CASE("is any/empty/count correct for empty source set", "[source_set]")
+{
+    for (const int maxCount : sourceCounts)
+    {
+        SourceSet sourceSet(maxCount);
+
+        REQUIRE(not sourceSet.any());
+        REQUIRE(sourceSet.empty());
+
+        REQUIRE(sourceSet.count() == 0);
+    }
+}
+
+TEST_CASE("is any/empty/count correct for full source set", "[source_set]")
+{
+    for (const int maxCount : sourceCounts)
+    {
+        SourceSet sourceSet(maxCount);
+        sourceSet.set();
+
+        REQUIRE(sourceSet.any());
+        REQUIRE(not sourceSet.empty());
+
+        REQUIRE(sourceSet.count() == maxCount);
+        REQUIRE(sourceSet.test(0));
+        REQUIRE(sourceSet.test(maxCount - 1));
+    }
+}
+
+TEST_CASE("is initializer list constructor without max count correct for source set", "[source_set]")
+{
+    SourceSet sourceSet{ 1, 2, 4 };
+
+    REQUIRE(sourceSet.toSet() == set<int>{ 1, 2, 4 });
+    REQUIRE(SourceSet{ }.empty());
+}
+
+TEST_CASE("is set/reset and test correct for source set", "[source_set]")
+{
+    for (const int maxCount : sourceCounts)
+    {
+        SourceSet sourceSet(maxCount);
+        const int last = maxCount - 1;
+
+        sourceSet.set(1);
+        sourceSet.set(last);
+
+        REQUIRE(sourceSet.test(1));
+        REQUIRE(not sourceSet.test(2));
+        REQUIRE(sourceSet.test(last));
+
+        sourceSet.reset(1);
+
+        REQUIRE(not sourceSet.test(1));
+        REQUIRE(sourceSet.test(last));
+        REQUIRE(sourceSet.count() == 1);
+
+        sourceSet.flip();
+
+        REQUIRE(sourceSet.test(1));
+        REQUIRE(not sourceSet.test(last));
+        REQUIRE(sourceSet.count() == maxCount - 1);
+
+        // Setting and resetting a complemented set updates the stored complement.
+        sourceSet.set(last);
+        sourceSet.reset(0);
+
+        REQUIRE(sourceSet.test(last));
+        REQUIRE(not sourceSet.test(0));
+        REQUIRE(sourceSet.count() == maxCount - 1);
+    }
+}
+
+TEST_CASE("is compacting preserving source set elements for all densities", "[source_set]")
+{
+    mt19937 mt(random_device{}());
+
+    for (const int maxCount : sourceCounts)
+    {
+        for (const double density : { 0.001, 0.1, 0.5, 0.9, 0.999 })
+        {
+            const set<int> elements = genRandomSet(maxCount, density, mt);
+
+            SourceSet sourceSet = toSourceSet(maxCount, elements);
+            const SourceSet uncompacted = sourceSet;
+
+            sourceSet.compact();
+
+            REQUIRE(sourceSet.toSet() == elements);
+            REQUIRE(sourceSet.count() == static_cast<int>(elements.size()));
+            REQUIRE(sourceSet == uncompacted);
+        }
+    }
+}
+
+TEST_CASE("is a dense compacted source set smaller than the explicit one", "[source_set]")
+{
+    const int maxCount = 100'000;
+
+    SourceSet sourceSet(maxCount);
+    sourceSet.set();
+
+    for (int n = 0; n < maxCount; n += 1'000)
+    {
+        sourceSet.reset(n);
+    }
+
+    SourceSet explicitSet = toSourceSet(maxCount, sourceSet.toSet());
+    explicitSet.compact();
+
+    REQUIRE(explicitSet == sourceSet);
+    // Only the 100 missing sources are stored, as a sorted array of 16-bit offsets per container.
+    REQUIRE(explicitSet.sizeInBytes() < 1'000);
+}
+
+TEST_CASE("is AND operator correct for random source sets", "[source_set]")
+{
+    mt19937 mt(random_device{}());
+
+    repeat(nRandIter, [&mt] {
+        for (const int maxCount : sourceCounts)
+        {
+            for (const double density1 : { 0.01, 0.3, 0.95 })
+            {
+                for (const double density2 : { 0.01, 0.3, 0.95 })
+                {
+                    const set<int> elements1 = genRandomSet(maxCount, density1, mt);
+                    const set<int> elements2 = genRandomSet(maxCount, density2, mt);
+
+                    set<int> expected;
+                    set_intersection(elements1.begin(), elements1.end(), elements2.begin(), elements2.end(), inserter(expected, expected.end()));
+
+                    SourceSet sourceSet1 = toSourceSet(maxCount, elements1), sourceSet2 = toSourceSet(maxCount, elements2);
+                    REQUIRE((sourceSet1 & sourceSet2).toSet() == expected);
+
+                    // Compacting may switch both operands to complements.
+                    sourceSet1.compact();
+                    sourceSet2.compact();
+
+                    const SourceSet res = (sourceSet1 & sourceSet2);
+
+                    REQUIRE(res.toSet() == expected);
+                    REQUIRE(res.count() == static_cast<int>(expected.size()));
+                    REQUIRE(res.any() == not expected.empty());
+                }
+            }
+        }
+    });
+}
+
+TEST_CASE("is OR equal operator correct for random source sets", "[source_set]")
+{
+    mt19937 mt(random_device{}());
+
+    repeat(nRandIter, [&mt] {
+        for (const int maxCount : sourceCounts)
+        {
+            for (const double density1 : { 0.01, 0.3, 0.95 })
+            {
+                for (const double density2 : { 0.01, 0.3, 0.95 })
+                {
+                    const set<int> elements1 = genRandomSet(maxCount, density1, mt);
+                    const set<int> elements2 = genRandomSet(maxCount, density2, mt);
+
+                    set<int> expected;
+                    set_union(elements1.begin(), elements1.end(), elements2.begin(), elements2.end(), inserter(expected, expected.end()));
+
+                    SourceSet sourceSet1 = toSourceSet(maxCount, elements1), sourceSet2 = toSourceSet(maxCount, elements2);
+
+                    sourceSet1.compact();
+                    sourceSet2.compact();
+
+                    sourceSet1 |= sourceSet2;
+
+                    REQUIRE(sourceSet1.toSet() == expected);
+                    REQUIRE(sourceSet1.count() == static_cast<int>(expected.size()));
+                    REQUIRE(sourceSet2.toSet() == elements2);
+                }
+            }
+        }
+    });
+}
+
+TEST_CASE("is equality correct for source sets with different representations", "[source_set]")
+{
+    const int maxCount = 1'000;
+
+    SourceSet sourceSet1(maxCount), sourceSet2(maxCount);
+
+    for (int n = 0; n < maxCount; n += 2)
+    {
+        sourceSet1.set(n);
+        sourceSet2.set(n);
+    }
+
+    sourceSet2.set(1);
+    sourceSet2.reset(1);
+    sourceSet2.compact();
+
+    REQUIRE(sourceSet1 == sourceSet2);
+
+    sourceSet2.reset(0);
+    REQUIRE(not (sourceSet1 == sourceSet2));
+
+    REQUIRE(SourceSet{ 8, 50, 51 } == set<int>{ 8, 50, 51 });
+    REQUIRE(SourceSet{ 8, 50, 51 } == SourceSet(maxCount, { 8, 50, 51 }));
+}
+
+} // namespace sopang
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include "../thread_pool.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace sopang
+{
+
+TEST_CASE("is running tasks correct for a single worker", "[thread_pool]")
+{
+    ThreadPool pool(1);
+    REQUIRE(pool.size() == 1);
+
+    vector<int> res;
+    pool.run(5, [&res](int taskIdx, int workerIdx) {
+        REQUIRE(workerIdx == 0);
+        res.push_back(taskIdx);
+    });
+
+    REQUIRE(res == vector<int>{ 0, 1, 2, 3, 4 });
+}
+
+TEST_CASE("is each task run exactly once for multiple workers and runs", "[thread_pool]")
+{
+    ThreadPool pool(4);
+
+    for (int nTasks : { 0, 1, 3, 100, 1000 })
+    {
+        vector<atomic<int>> counts(nTasks);
+        atomic<int> maxWorkerIdx{ 0 };
+
+        pool.run(nTasks, [&](int taskIdx, int workerIdx) {
+            counts[taskIdx] += 1;
+
+            if (workerIdx > maxWorkerIdx)
+            {
+                maxWorkerIdx = workerIdx;
+            }
+        });
+
+        for (const atomic<int> &count : counts)
+        {
+            REQUIRE(count == 1);
+        }
+
+        REQUIRE(maxWorkerIdx < pool.size());
+    }
+}
+
+TEST_CASE("is task exception rethrown and pool reusable afterwards", "[thread_pool]")
+{
+    ThreadPool pool(3);
+
+    REQUIRE_THROWS_AS(pool.run(10, [](int taskIdx, int) {
+        if (taskIdx == 5)
+        {
+            throw runtime_error("task failed");
+        }
+    }), runtime_error);
+
+    atomic<int> nRun{ 0 };
+    pool.run(10, [&nRun](int, int) { nRun += 1; });
+
+    REQUIRE(nRun == 10);
+}
+
+} // namespace sopang